@@ -0,0 +1,203 @@
+// Edge capture engine
+//
+// GPIOTE IN event -> PPI -> TIMER capture into one of EDGE_CAPTURE_SLOTS
+//  capture registers. PPI channel groups rotate the capture register on every
+//  edge, and a second TIMER counts the edges. The counter interrupts once per
+//  EDGE_CAPTURE_BATCH edges, and the handler drains the whole batch into a
+//  single-producer, single-consumer ring buffer. Edge n lands in register
+//  n % EDGE_CAPTURE_SLOTS, so the count also tells the handler which registers
+//  hold new timestamps and which were overwritten before it got to them.
+//
+// Each slot k uses a group of two PPI channels, both on the GPIOTE event:
+//  channel A captures into CC[k] and forks to disable group k
+//  channel B enables group k + 1 and forks to count the edge
+//  Only one group is enabled at a time, so every edge is captured and counted
+//  once.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+
+#include "edge_capture.h"
+
+#if (EDGE_CAPTURE_BUFFER_SIZE & (EDGE_CAPTURE_BUFFER_SIZE - 1)) != 0
+#error "EDGE_CAPTURE_BUFFER_SIZE must be a power of two"
+#endif
+
+// Counter registers: CC[0] interrupts at the end of the next batch, and the
+//  handler captures the edge count into CC[1]
+#define BATCH_CC 0
+#define COUNT_CC 1
+
+// Ring buffer. head is only written by the interrupt handler and tail only by
+//  the main loop, so neither needs a critical section
+static uint32_t buffer[EDGE_CAPTURE_BUFFER_SIZE];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+
+// Edges already drained out of the capture registers
+static uint32_t serviced_edges = 0;
+
+static volatile uint32_t captured = 0;
+static volatile uint32_t overflows = 0;
+static volatile uint32_t dropped = 0;
+
+static uint32_t read_edge_count(void) {
+  EDGE_CAPTURE_COUNTER->TASKS_CAPTURE[COUNT_CC] = 1;
+  return EDGE_CAPTURE_COUNTER->CC[COUNT_CC];
+}
+
+static void push(uint32_t timestamp) {
+  uint32_t next = head;
+  if (next - tail == EDGE_CAPTURE_BUFFER_SIZE) {
+    dropped++;
+    return;
+  }
+  buffer[next % EDGE_CAPTURE_BUFFER_SIZE] = timestamp;
+  head = next + 1;
+  captured++;
+}
+
+void EDGE_CAPTURE_COUNTER_IRQHandler(void) {
+  EDGE_CAPTURE_COUNTER->EVENTS_COMPARE[BATCH_CC] = 0;
+
+  uint32_t first = serviced_edges;
+  uint32_t edges = read_edge_count();
+
+  // Only the newest EDGE_CAPTURE_SLOTS edges still have their timestamps
+  if (edges - first > EDGE_CAPTURE_SLOTS) {
+    overflows += edges - first - EDGE_CAPTURE_SLOTS;
+    first = edges - EDGE_CAPTURE_SLOTS;
+  }
+
+  uint32_t timestamps[EDGE_CAPTURE_SLOTS];
+  uint32_t count = edges - first;
+  for (uint32_t i = 0; i < count; i++) {
+    timestamps[i] = EDGE_CAPTURE_TIMER->CC[(first + i) % EDGE_CAPTURE_SLOTS];
+  }
+
+  // Edges during the copy may have overwritten the oldest registers before they
+  //  were read. There is no telling which reads came first, so every register
+  //  reused since the count was taken counts as an overflow
+  uint32_t reused = read_edge_count() - first;
+  uint32_t lost = 0;
+  if (reused > EDGE_CAPTURE_SLOTS) {
+    lost = reused - EDGE_CAPTURE_SLOTS;
+    if (lost > count) {
+      lost = count;
+    }
+  }
+  overflows += lost;
+  for (uint32_t i = lost; i < count; i++) {
+    push(timestamps[i]);
+  }
+  serviced_edges = edges;
+
+  // Interrupt at the end of the next batch. If it already ended while this
+  //  handler ran, the compare has passed and will not fire, so run again
+  EDGE_CAPTURE_COUNTER->CC[BATCH_CC] = edges + EDGE_CAPTURE_BATCH;
+  if (read_edge_count() - edges >= EDGE_CAPTURE_BATCH) {
+    NVIC_SetPendingIRQ(EDGE_CAPTURE_COUNTER_IRQn);
+  }
+}
+
+// Drain edges that have not filled a batch yet, e.g. at the end of a burst
+static void drain_partial_batch(void) {
+  NVIC_SetPendingIRQ(EDGE_CAPTURE_COUNTER_IRQn);
+}
+
+void edge_capture_init(uint32_t pin, edge_capture_polarity_t polarity) {
+  // Input with no pull, so the source drives it
+  NRF_GPIOTE->CONFIG[EDGE_CAPTURE_GPIOTE_CHANNEL] = (GPIOTE_CONFIG_MODE_Event << GPIOTE_CONFIG_MODE_Pos) |
+                                                    (pin << GPIOTE_CONFIG_PSEL_Pos) |
+                                                    (polarity << GPIOTE_CONFIG_POLARITY_Pos);
+
+  // Free-running 16 MHz timestamp timer
+  EDGE_CAPTURE_TIMER->TASKS_STOP = 1;
+  EDGE_CAPTURE_TIMER->MODE = TIMER_MODE_MODE_Timer;
+  EDGE_CAPTURE_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  EDGE_CAPTURE_TIMER->PRESCALER = 0;
+  EDGE_CAPTURE_TIMER->TASKS_CLEAR = 1;
+
+  // Edge counter, interrupting after the first batch
+  EDGE_CAPTURE_COUNTER->TASKS_STOP = 1;
+  EDGE_CAPTURE_COUNTER->MODE = TIMER_MODE_MODE_LowPowerCounter;
+  EDGE_CAPTURE_COUNTER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  EDGE_CAPTURE_COUNTER->TASKS_CLEAR = 1;
+  EDGE_CAPTURE_COUNTER->CC[BATCH_CC] = EDGE_CAPTURE_BATCH;
+
+  head = 0;
+  tail = 0;
+  serviced_edges = 0;
+  captured = 0;
+  overflows = 0;
+  dropped = 0;
+
+  // Slot rotation, see the top of this file
+  uint32_t all_channels = 0;
+  for (uint32_t k = 0; k < EDGE_CAPTURE_SLOTS; k++) {
+    uint32_t capture_channel = EDGE_CAPTURE_PPI_FIRST_CHANNEL + 2 * k;
+    uint32_t advance_channel = capture_channel + 1;
+    uint32_t next = (k + 1) % EDGE_CAPTURE_SLOTS;
+
+    NRF_PPI->CH[capture_channel].EEP = (uint32_t)&NRF_GPIOTE->EVENTS_IN[EDGE_CAPTURE_GPIOTE_CHANNEL];
+    NRF_PPI->CH[capture_channel].TEP = (uint32_t)&EDGE_CAPTURE_TIMER->TASKS_CAPTURE[k];
+    NRF_PPI->FORK[capture_channel].TEP = (uint32_t)&NRF_PPI->TASKS_CHG[k].DIS;
+
+    NRF_PPI->CH[advance_channel].EEP = (uint32_t)&NRF_GPIOTE->EVENTS_IN[EDGE_CAPTURE_GPIOTE_CHANNEL];
+    NRF_PPI->CH[advance_channel].TEP = (uint32_t)&NRF_PPI->TASKS_CHG[next].EN;
+    NRF_PPI->FORK[advance_channel].TEP = (uint32_t)&EDGE_CAPTURE_COUNTER->TASKS_COUNT;
+
+    NRF_PPI->CHG[k] = (1u << capture_channel) | (1u << advance_channel);
+    all_channels |= NRF_PPI->CHG[k];
+  }
+  NRF_PPI->CHENCLR = all_channels;
+
+  // Batch interrupt. The handler has EDGE_CAPTURE_BATCH edge periods before
+  //  the registers it drains are reused, so the highest priority keeps
+  //  overflows rare
+  EDGE_CAPTURE_COUNTER->EVENTS_COMPARE[BATCH_CC] = 0;
+  EDGE_CAPTURE_COUNTER->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+  NVIC_ClearPendingIRQ(EDGE_CAPTURE_COUNTER_IRQn);
+  NVIC_SetPriority(EDGE_CAPTURE_COUNTER_IRQn, 0);
+  NVIC_EnableIRQ(EDGE_CAPTURE_COUNTER_IRQn);
+
+  EDGE_CAPTURE_COUNTER->TASKS_START = 1;
+  EDGE_CAPTURE_TIMER->TASKS_START = 1;
+
+  // The first edge goes to CC[0]
+  NRF_GPIOTE->EVENTS_IN[EDGE_CAPTURE_GPIOTE_CHANNEL] = 0;
+  NRF_PPI->TASKS_CHG[0].EN = 1;
+}
+
+uint32_t edge_capture_read(uint32_t* timestamps, uint32_t max_count) {
+  drain_partial_batch();
+
+  uint32_t first = tail;
+  uint32_t count = head - first;
+  if (count > max_count) {
+    count = max_count;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    timestamps[i] = buffer[(first + i) % EDGE_CAPTURE_BUFFER_SIZE];
+  }
+
+  // hand the slots back only after they are copied
+  __DMB();
+  tail = first + count;
+  return count;
+}
+
+uint32_t edge_capture_available(void) {
+  drain_partial_batch();
+  return head - tail;
+}
+
+void edge_capture_get_stats(edge_capture_stats_t* stats) {
+  stats->edges = read_edge_count();
+  stats->captured = captured;
+  stats->overflows = overflows;
+  stats->dropped = dropped;
+}
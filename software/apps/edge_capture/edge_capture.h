@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "nrf.h"
+
+// Capture timer ticks per microsecond
+#define EDGE_CAPTURE_TICKS_PER_US 16
+
+// Number of timestamps the ring buffer holds. Must be a power of two
+#ifndef EDGE_CAPTURE_BUFFER_SIZE
+#define EDGE_CAPTURE_BUFFER_SIZE 1024
+#endif
+
+// Hardware used by the capture engine. Timestamps rotate through the six
+//  capture registers of EDGE_CAPTURE_TIMER, which must be TIMER3 or TIMER4.
+//  The rotation takes PPI channels EDGE_CAPTURE_PPI_FIRST_CHANNEL to
+//  EDGE_CAPTURE_PPI_FIRST_CHANNEL + 11 and all six PPI channel groups
+#define EDGE_CAPTURE_GPIOTE_CHANNEL 0
+#define EDGE_CAPTURE_PPI_FIRST_CHANNEL 0
+#define EDGE_CAPTURE_TIMER NRF_TIMER3
+#define EDGE_CAPTURE_COUNTER NRF_TIMER2
+#define EDGE_CAPTURE_COUNTER_IRQn TIMER2_IRQn
+#define EDGE_CAPTURE_COUNTER_IRQHandler TIMER2_IRQHandler
+
+// Capture registers the timestamps rotate through, and edges per interrupt.
+//  The interrupt comes after half of the registers are filled, so the handler
+//  can be held off for another EDGE_CAPTURE_BATCH edges before any is lost
+#define EDGE_CAPTURE_SLOTS 6
+#define EDGE_CAPTURE_BATCH (EDGE_CAPTURE_SLOTS / 2)
+
+typedef enum {
+  EDGE_CAPTURE_RISING = 1,
+  EDGE_CAPTURE_FALLING = 2,
+  EDGE_CAPTURE_BOTH = 3,
+} edge_capture_polarity_t;
+
+typedef struct {
+  // edges seen by the hardware counter
+  uint32_t edges;
+  // timestamps put in the ring buffer
+  uint32_t captured;
+  // capture register overflows: edges whose timestamp was overwritten by a
+  //  later edge before the interrupt drained it. Their timestamps are lost
+  uint32_t overflows;
+  // timestamps lost because the ring buffer was full
+  uint32_t dropped;
+} edge_capture_stats_t;
+
+// Start capturing edges on <pin>
+// Timestamps are in ticks of EDGE_CAPTURE_TICKS_PER_US and wrap every 268
+//  seconds, so compare them by subtraction
+void edge_capture_init(uint32_t pin, edge_capture_polarity_t polarity);
+
+// Copy up to <max_count> timestamps, oldest first, out of the ring buffer
+// Edges still waiting for a full batch are drained into the buffer first
+// Returns the number copied
+uint32_t edge_capture_read(uint32_t* timestamps, uint32_t max_count);
+
+// Returns the number of timestamps waiting in the ring buffer
+uint32_t edge_capture_available(void);
+
+// Get the edge counts since edge_capture_init()
+void edge_capture_get_stats(edge_capture_stats_t* stats);
@@ -0,0 +1,83 @@
+// Edge capture app
+//
+// Timestamps edges on an input pin with GPIOTE, PPI and TIMER capture
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "nrf.h"
+#include "nrf_delay.h"
+
+#include "microbit_v2.h"
+#include "edge_capture.h"
+
+// Test signal on EDGE_P1, toggled in hardware. Wire it to EDGE_P2
+#define SIGNAL_GPIOTE_CHANNEL 1
+// after the channels the capture engine uses
+#define SIGNAL_PPI_CHANNEL (EDGE_CAPTURE_PPI_FIRST_CHANNEL + 2 * EDGE_CAPTURE_SLOTS)
+#define SIGNAL_TOGGLE_US 25
+
+#define BATCH_SIZE 64
+
+// Toggle EDGE_P1 every SIGNAL_TOGGLE_US with TIMER1, PPI and GPIOTE
+static void signal_start(void) {
+  NRF_GPIOTE->CONFIG[SIGNAL_GPIOTE_CHANNEL] = (GPIOTE_CONFIG_MODE_Task << GPIOTE_CONFIG_MODE_Pos) |
+                                              (EDGE_P1 << GPIOTE_CONFIG_PSEL_Pos) |
+                                              (GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos);
+
+  NRF_TIMER1->MODE = TIMER_MODE_MODE_Timer;
+  NRF_TIMER1->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  NRF_TIMER1->PRESCALER = 0;
+  NRF_TIMER1->CC[0] = SIGNAL_TOGGLE_US * EDGE_CAPTURE_TICKS_PER_US;
+  NRF_TIMER1->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+
+  NRF_PPI->CH[SIGNAL_PPI_CHANNEL].EEP = (uint32_t)&NRF_TIMER1->EVENTS_COMPARE[0];
+  NRF_PPI->CH[SIGNAL_PPI_CHANNEL].TEP = (uint32_t)&NRF_GPIOTE->TASKS_OUT[SIGNAL_GPIOTE_CHANNEL];
+  NRF_PPI->CHENSET = 1u << SIGNAL_PPI_CHANNEL;
+
+  NRF_TIMER1->TASKS_START = 1;
+}
+
+int main(void) {
+  printf("Board started!\n");
+
+  edge_capture_init(EDGE_P2, EDGE_CAPTURE_BOTH);
+  signal_start();
+
+  // Drain the buffer in batches, and report once a second
+  static uint32_t timestamps[BATCH_SIZE];
+  uint32_t previous = 0;
+  bool have_previous = false;
+  uint64_t total_ticks = 0;
+  uint32_t intervals = 0;
+  uint32_t loops = 0;
+
+  while (1) {
+    uint32_t count;
+    while ((count = edge_capture_read(timestamps, BATCH_SIZE)) != 0) {
+      for (uint32_t i = 0; i < count; i++) {
+        if (have_previous) {
+          total_ticks += timestamps[i] - previous;
+          intervals++;
+        }
+        previous = timestamps[i];
+        have_previous = true;
+      }
+    }
+
+    loops++;
+    if (loops == 100) {
+      edge_capture_stats_t stats;
+      edge_capture_get_stats(&stats);
+      uint32_t average_ns = intervals ? (uint32_t)(total_ticks * 1000 / EDGE_CAPTURE_TICKS_PER_US / intervals) : 0;
+      printf("%lu edges/s, average interval %lu ns, %lu captured, %lu overflows, %lu dropped\n",
+          intervals, average_ns, stats.captured, stats.overflows, stats.dropped);
+      total_ticks = 0;
+      intervals = 0;
+      loops = 0;
+    }
+
+    nrf_delay_ms(10);
+  }
+}
@@ -1,28 +1,52 @@
 #include "gpio.h"
 
 typedef struct{
-  // Step 3:
-  // Add register definitions here
+  uint32_t _unused_A[321];
+  uint32_t OUT;
+  uint32_t OUTSET;
+  uint32_t OUTCLR;
+  uint32_t IN;
+  uint32_t DIR;
+  uint32_t DIRSET;
+  uint32_t DIRCLR;
+  uint32_t LATCH;
+  uint32_t DETECTMODE;
+  uint32_t _unused_B[118];
+  uint32_t PIN_CNF[32];
 } gpio_reg_t;
 
+// P0 and P1 register blocks
+static volatile gpio_reg_t* const gpio_ports[GPIO_PORTS] = {
+  (volatile gpio_reg_t*)(0x50000000),
+  (volatile gpio_reg_t*)(0x50000300),
+};
+
 // Inputs: 
 //  gpio_num - gpio number 0-31 OR (32 + gpio number)
 //  dir - gpio direction (INPUT, OUTPUT)
 void gpio_config(uint8_t gpio_num, gpio_direction_t dir) {
-  // Implement me
-  // Hint: Use proper PIN_CNF instead of DIR
+  volatile gpio_reg_t* port = gpio_ports[gpio_num >> 5];
+  uint8_t pin = gpio_num & 0x1F;
+
+  if (dir == GPIO_OUTPUT) {
+    // DIR output, input buffer disconnected
+    port->PIN_CNF[pin] = 3;
+  } else {
+    // DIR input, input buffer connected
+    port->PIN_CNF[pin] = 0;
+  }
 }
 
 // Inputs: 
 //  gpio_num - gpio number 0-31 OR (32 + gpio number)
 void gpio_set(uint8_t gpio_num) {
-  // Implement me
+  gpio_ports[gpio_num >> 5]->OUTSET = 1u << (gpio_num & 0x1F);
 }
 
 // Inputs: 
 //  gpio_num - gpio number 0-31 OR (32 + gpio number)
 void gpio_clear(uint8_t gpio_num) {
-  // Implement me
+  gpio_ports[gpio_num >> 5]->OUTCLR = 1u << (gpio_num & 0x1F);
 }
 
 // Inputs: 
@@ -30,8 +54,90 @@ void gpio_clear(uint8_t gpio_num) {
 // Output:
 //  bool - pin state (true == high)
 bool gpio_read(uint8_t gpio_num) {
-  // Implement me
+  return (gpio_ports[gpio_num >> 5]->IN >> (gpio_num & 0x1F)) & 1;
+}
+
+// Inputs:
+//  port - gpio port (0 or 1)
+//  set_mask - pins to drive high
+//  clear_mask - pins to drive low
+void gpio_write_mask(uint8_t port, uint32_t set_mask, uint32_t clear_mask) {
+  // OUTSET and OUTCLR only touch the given pins, so there is no
+  //  read-modify-write of OUT for an interrupt to race with
+  if (set_mask != 0) {
+    gpio_ports[port]->OUTSET = set_mask;
+  }
+  if (clear_mask != 0) {
+    gpio_ports[port]->OUTCLR = clear_mask;
+  }
+}
+
+// Inputs:
+//  port - gpio port (0 or 1)
+// Output:
+//  uint32_t - input state of all 32 pins of the port
+uint32_t gpio_read_port(uint8_t port) {
+  return gpio_ports[port]->IN;
+}
+
+// Inputs:
+//  group - group to fill in
+//  gpio_nums - gpio numbers 0-31 OR (32 + gpio number)
+//  count - number of gpio numbers
+void gpio_group_init(gpio_group_t* group, const uint8_t* gpio_nums, uint8_t count) {
+  for (uint8_t port = 0; port < GPIO_PORTS; port++) {
+    group->mask[port] = 0;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    group->mask[gpio_nums[i] >> 5] |= 1u << (gpio_nums[i] & 0x1F);
+  }
+}
 
-  return true;
+// Inputs:
+//  group - pins to configure
+//  dir - gpio direction (INPUT, OUTPUT)
+void gpio_group_config(const gpio_group_t* group, gpio_direction_t dir) {
+  // PIN_CNF has one register per pin, so this cannot be batched
+  for (uint8_t port = 0; port < GPIO_PORTS; port++) {
+    for (uint8_t pin = 0; pin < 32; pin++) {
+      if (group->mask[port] & (1u << pin)) {
+        gpio_config((port << 5) | pin, dir);
+      }
+    }
+  }
 }
 
+// Inputs:
+//  group - pins to drive high
+void gpio_group_set(const gpio_group_t* group) {
+  for (uint8_t port = 0; port < GPIO_PORTS; port++) {
+    gpio_write_mask(port, group->mask[port], 0);
+  }
+}
+
+// Inputs:
+//  group - pins to drive low
+void gpio_group_clear(const gpio_group_t* group) {
+  for (uint8_t port = 0; port < GPIO_PORTS; port++) {
+    gpio_write_mask(port, 0, group->mask[port]);
+  }
+}
+
+// Inputs:
+//  group - pins to change
+//  high - pins to drive high
+void gpio_group_write(const gpio_group_t* group, const gpio_group_t* high) {
+  for (uint8_t port = 0; port < GPIO_PORTS; port++) {
+    gpio_write_mask(port, group->mask[port] & high->mask[port],
+        group->mask[port] & ~high->mask[port]);
+  }
+}
+
+// Inputs:
+//  group - pins to read
+//  state - filled in with the pins of the group that are high
+void gpio_group_read(const gpio_group_t* group, gpio_group_t* state) {
+  for (uint8_t port = 0; port < GPIO_PORTS; port++) {
+    state->mask[port] = group->mask[port] != 0 ? gpio_read_port(port) & group->mask[port] : 0;
+  }
+}
@@ -8,6 +8,16 @@ typedef enum {
   GPIO_OUTPUT,
 } gpio_direction_t;
 
+// Number of GPIO ports (P0 and P1)
+#define GPIO_PORTS 2
+
+// A set of pins, kept as one bit mask per port so the whole set can be
+//  changed with at most two stores per port
+// Build one with gpio_group_init() once and reuse it
+typedef struct {
+  uint32_t mask[GPIO_PORTS];
+} gpio_group_t;
+
 // Inputs: 
 //  gpio_num - gpio number 0-31 OR (32 + gpio number)
 //  dir - gpio direction (INPUT, OUTPUT)
@@ -27,3 +37,48 @@ void gpio_clear(uint8_t gpio_num);
 //  current state of the specified gpio pin (true == high)
 bool gpio_read(uint8_t gpio_num);
 
+// Sets and clears several pins of one port at once
+// Each of OUTSET and OUTCLR is written only if its mask is nonzero. A pin in
+//  both masks ends up cleared
+// Inputs:
+//  port - gpio port (0 or 1)
+//  set_mask - pins to drive high
+//  clear_mask - pins to drive low
+void gpio_write_mask(uint8_t port, uint32_t set_mask, uint32_t clear_mask);
+
+// Inputs:
+//  port - gpio port (0 or 1)
+// Returns:
+//  input state of all 32 pins of the port (bit n == pin n)
+uint32_t gpio_read_port(uint8_t port);
+
+// Inputs:
+//  group - group to fill in
+//  gpio_nums - gpio numbers 0-31 OR (32 + gpio number), such as the pins in
+//   microbit_v2.h
+//  count - number of gpio numbers
+void gpio_group_init(gpio_group_t* group, const uint8_t* gpio_nums, uint8_t count);
+
+// Inputs:
+//  group - pins to configure
+//  dir - gpio direction (INPUT, OUTPUT)
+void gpio_group_config(const gpio_group_t* group, gpio_direction_t dir);
+
+// Inputs:
+//  group - pins to drive high
+void gpio_group_set(const gpio_group_t* group);
+
+// Inputs:
+//  group - pins to drive low
+void gpio_group_clear(const gpio_group_t* group);
+
+// Drives the pins of <group> that are also in <high> high, and the rest low
+// Inputs:
+//  group - pins to change
+//  high - pins to drive high, usually a subset of group
+void gpio_group_write(const gpio_group_t* group, const gpio_group_t* high);
+
+// Inputs:
+//  group - pins to read
+//  state - filled in with the pins of the group that are high
+void gpio_group_read(const gpio_group_t* group, gpio_group_t* state);
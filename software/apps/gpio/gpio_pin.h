@@ -0,0 +1,50 @@
+#pragma once
+
+// Compile-time GPIO pin access
+//
+// The gpio.c functions take the pin at runtime, so every call decodes the port
+//  and bit and goes through a function call. These macros take a constant pin
+//  such as LED_MIC from microbit_v2.h instead. The port address and bit mask
+//  are then folded by the compiler, and each access is a single store or load
+//  with no branches. Passing a pin that is not a compile-time constant is an
+//  error.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+
+// Fails to compile unless <pin> is a constant expression
+#define GPIO_PIN_CHECK(pin) \
+  ((void)sizeof(struct { \
+    _Static_assert(__builtin_constant_p(pin), "pin must be a compile-time constant"); \
+    int unused; \
+  }))
+
+// Port registers and bit mask for a pin number 0-31 OR (32 + gpio number)
+#define GPIO_PIN_PORT(pin) ((NRF_GPIO_Type*)((pin) >= 32 ? NRF_P1_BASE : NRF_P0_BASE))
+#define GPIO_PIN_BIT(pin) (1u << ((pin) & 0x1F))
+
+// Configures <pin> as an output with the input buffer disconnected
+#define GPIO_PIN_CONFIG_OUTPUT(pin) \
+  (GPIO_PIN_CHECK(pin), GPIO_PIN_PORT(pin)->PIN_CNF[(pin) & 0x1F] = \
+      (GPIO_PIN_CNF_DIR_Output << GPIO_PIN_CNF_DIR_Pos) | \
+      (GPIO_PIN_CNF_INPUT_Disconnect << GPIO_PIN_CNF_INPUT_Pos))
+
+// Configures <pin> as an input with the input buffer connected
+#define GPIO_PIN_CONFIG_INPUT(pin) \
+  (GPIO_PIN_CHECK(pin), GPIO_PIN_PORT(pin)->PIN_CNF[(pin) & 0x1F] = \
+      (GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos) | \
+      (GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos))
+
+// Drives <pin> high
+#define GPIO_PIN_SET(pin) \
+  (GPIO_PIN_CHECK(pin), GPIO_PIN_PORT(pin)->OUTSET = GPIO_PIN_BIT(pin))
+
+// Drives <pin> low
+#define GPIO_PIN_CLEAR(pin) \
+  (GPIO_PIN_CHECK(pin), GPIO_PIN_PORT(pin)->OUTCLR = GPIO_PIN_BIT(pin))
+
+// Evaluates to true if <pin> is high
+#define GPIO_PIN_READ(pin) \
+  (GPIO_PIN_CHECK(pin), (GPIO_PIN_PORT(pin)->IN & GPIO_PIN_BIT(pin)) != 0)
@@ -11,15 +11,83 @@
 
 #include "microbit_v2.h"
 #include "gpio.h"
+#include "gpio_pin.h"
+
+#define COMPARE_ITERATIONS 1000
+
+// One set and one clear of the microphone LED through each pin access layer.
+//  Kept out of line so their sizes show up separately in the symbol table
+__attribute__((noinline)) static void pulse_empty(void) {
+  __asm__ volatile ("");
+}
+
+__attribute__((noinline)) static void pulse_gpio_c(void) {
+  gpio_set(LED_MIC);
+  gpio_clear(LED_MIC);
+}
+
+__attribute__((noinline)) static void pulse_nrf_gpio(void) {
+  nrf_gpio_pin_set(LED_MIC);
+  nrf_gpio_pin_clear(LED_MIC);
+}
+
+__attribute__((noinline)) static void pulse_gpio_pin(void) {
+  GPIO_PIN_SET(LED_MIC);
+  GPIO_PIN_CLEAR(LED_MIC);
+}
+
+// Returns the average cycles per call of <pulse>
+static uint32_t measure_pulse(void (*pulse)(void)) {
+  uint32_t start = DWT->CYCCNT;
+  for (uint32_t i = 0; i < COMPARE_ITERATIONS; i++) {
+    pulse();
+  }
+  return (DWT->CYCCNT - start) / COMPARE_ITERATIONS;
+}
+
+// Prints the cycles for a set and clear through gpio.c, the SDK's nrf_gpio
+//  functions and gpio_pin.h. Code size is in the symbol table:
+//  arm-none-eabi-nm --size-sort _build/gpio.out | grep pulse_
+static void compare_pin_access(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  GPIO_PIN_CONFIG_OUTPUT(LED_MIC);
+  uint32_t empty = measure_pulse(pulse_empty);
+  printf("Cycles per set + clear, loop and call overhead removed:\n");
+  printf("  gpio.c      %lu\n", measure_pulse(pulse_gpio_c) - empty);
+  printf("  nrf_gpio    %lu\n", measure_pulse(pulse_nrf_gpio) - empty);
+  printf("  gpio_pin.h  %lu\n", measure_pulse(pulse_gpio_pin) - empty);
+}
 
 int main(void) {
   printf("Board started!\n");
 
+  compare_pin_access();
+
   // Step 2:
   // Control LED with raw MMIO
   // Microphone LED is P0.20 and active high
   // Add code here
 
+  // Drive the LED matrix rows and columns as groups. Each group update is at
+  //  most two stores per port instead of one store per pin
+  static const uint8_t row_pins[] = {LED_ROW1, LED_ROW2, LED_ROW3, LED_ROW4, LED_ROW5};
+  static const uint8_t col_pins[] = {LED_COL1, LED_COL2, LED_COL3, LED_COL4, LED_COL5};
+  gpio_group_t rows;
+  gpio_group_t cols;
+  gpio_group_init(&rows, row_pins, sizeof(row_pins));
+  gpio_group_init(&cols, col_pins, sizeof(col_pins));
+  gpio_group_clear(&rows);
+  gpio_group_set(&cols);
+  gpio_group_config(&rows, GPIO_OUTPUT);
+  gpio_group_config(&cols, GPIO_OUTPUT);
+
+  // the buttons are read as a port below, so their input buffers must be
+  //  connected
+  gpio_config(BTN_A, GPIO_INPUT);
+  gpio_config(BTN_B, GPIO_INPUT);
+
   // loop forever
   printf("Looping\n");
   while (1) {
@@ -30,6 +98,17 @@ int main(void) {
     // Button B is P0.23 and active low
     // Add code here
 
+    // Light the whole matrix while both buttons are held. Both buttons are
+    //  on P0, so one port read covers them
+    uint32_t buttons = (1u << (BTN_A & 0x1F)) | (1u << (BTN_B & 0x1F));
+    if ((gpio_read_port(0) & buttons) == 0) {
+      gpio_group_clear(&cols);
+      gpio_group_set(&rows);
+    } else {
+      gpio_group_clear(&rows);
+      gpio_group_set(&cols);
+    }
+
     nrf_delay_ms(100);
   }
 }
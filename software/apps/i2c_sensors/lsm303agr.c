@@ -6,6 +6,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "app_error.h"
 #include "lsm303agr.h"
 #include "nrf_delay.h"
 
@@ -21,20 +22,66 @@ static const nrf_twi_mngr_t* i2c_manager = NULL;
 static uint8_t i2c_reg_read(uint8_t i2c_addr, uint8_t reg_addr) {
   uint8_t rx_buf = 0;
   nrf_twi_mngr_transfer_t const read_transfer[] = {
-    //TODO: implement me
+    NRF_TWI_MNGR_WRITE(i2c_addr, &reg_addr, 1, NRF_TWI_MNGR_NO_STOP),
+    NRF_TWI_MNGR_READ(i2c_addr, &rx_buf, 1, 0),
   };
-  nrf_twi_mngr_perform(i2c_manager, NULL, read_transfer, 2, NULL);
+  ret_code_t error_code = nrf_twi_mngr_perform(i2c_manager, NULL, read_transfer, 2, NULL);
+  APP_ERROR_CHECK(error_code);
 
   return rx_buf;
 }
 
+// Helper function to read consecutive registers in one I2C transaction
+// The register address is sent once and the device steps through the
+//  registers after it, so the bus carries one address phase instead of one per
+//  byte. The accelerometer only steps if the MSB of the register address is
+//  set (LSM303AGR_ACC_AUTO_INCREMENT), while the magnetometer always does
+//
+// i2c_addr - address of the device to read from
+// reg_addr - address of the first register, including the auto-increment bit
+// data - buffer for <length> bytes
+static void i2c_reg_read_burst(uint8_t i2c_addr, uint8_t reg_addr, uint8_t* data, uint8_t length) {
+  nrf_twi_mngr_transfer_t const read_transfer[] = {
+    NRF_TWI_MNGR_WRITE(i2c_addr, &reg_addr, 1, NRF_TWI_MNGR_NO_STOP),
+    NRF_TWI_MNGR_READ(i2c_addr, data, length, 0),
+  };
+  ret_code_t error_code = nrf_twi_mngr_perform(i2c_manager, NULL, read_transfer, 2, NULL);
+  APP_ERROR_CHECK(error_code);
+}
+
 // Helper function to perform a 1-byte I2C write of a given register
 //
 // i2c_addr - address of the device to write to
 // reg_addr - address of the register within the device to write
 static void i2c_reg_write(uint8_t i2c_addr, uint8_t reg_addr, uint8_t data) {
-  //TODO: implement me
-  //Note: there should only be a single two-byte transfer to be performed
+  uint8_t tx_buf[2] = {reg_addr, data};
+  nrf_twi_mngr_transfer_t const write_transfer[] = {
+    NRF_TWI_MNGR_WRITE(i2c_addr, tx_buf, 2, 0),
+  };
+  ret_code_t error_code = nrf_twi_mngr_perform(i2c_manager, NULL, write_transfer, 1, NULL);
+  APP_ERROR_CHECK(error_code);
+}
+
+// Read the six output registers of X, Y and Z, low byte first, into signed
+//  16-bit values
+//
+// i2c_addr - address of the device to read from
+// reg_addr - address of the X low byte, including the auto-increment bit
+static void read_axes(uint8_t i2c_addr, uint8_t reg_addr, int16_t axes[3]) {
+  uint8_t data[6] = {0};
+#if LSM303AGR_BURST_READS
+  i2c_reg_read_burst(i2c_addr, reg_addr, data, sizeof(data));
+#else
+  // one transaction per byte
+  reg_addr &= ~LSM303AGR_ACC_AUTO_INCREMENT;
+  for (uint8_t i = 0; i < sizeof(data); i++) {
+    data[i] = i2c_reg_read(i2c_addr, reg_addr + i);
+  }
+#endif
+
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    axes[axis] = (int16_t)((data[2 * axis + 1] << 8) | data[2 * axis]);
+  }
 }
 
 // Initialize and configure the LSM303AGR accelerometer/magnetometer
@@ -95,16 +142,26 @@ float lsm303agr_read_temperature(void) {
 }
 
 lsm303agr_measurement_t lsm303agr_read_accelerometer(void) {
-  //TODO: implement me
+  int16_t axes[3];
+  read_axes(LSM303AGR_ACC_ADDRESS, LSM303AGR_ACC_OUT_X_L | LSM303AGR_ACC_AUTO_INCREMENT, axes);
 
+  // normal mode data is 10 bits, left aligned, at 3.9 mg per digit
   lsm303agr_measurement_t measurement = {0};
+  measurement.x_axis = (axes[0] >> 6) * 3.9 / 1000.0;
+  measurement.y_axis = (axes[1] >> 6) * 3.9 / 1000.0;
+  measurement.z_axis = (axes[2] >> 6) * 3.9 / 1000.0;
   return measurement;
 }
 
 lsm303agr_measurement_t lsm303agr_read_magnetometer(void) {
-  //TODO: implement me
+  int16_t axes[3];
+  read_axes(LSM303AGR_MAG_ADDRESS, LSM303AGR_MAG_OUT_X_L_REG, axes);
 
+  // 1.5 milligauss per digit, which is 0.15 uT
   lsm303agr_measurement_t measurement = {0};
+  measurement.x_axis = axes[0] * 0.15;
+  measurement.y_axis = axes[1] * 0.15;
+  measurement.z_axis = axes[2] * 0.15;
 
   return measurement;
 }
@@ -8,6 +8,16 @@
 static const uint8_t LSM303AGR_ACC_ADDRESS = 0x19;
 static const uint8_t LSM303AGR_MAG_ADDRESS = 0x1E;
 
+// Read the three axes of each sensor in one I2C transaction, rather than one
+//  transaction per register
+#ifndef LSM303AGR_BURST_READS
+#define LSM303AGR_BURST_READS 1
+#endif
+
+// Set in an accelerometer register address to read or write the registers
+//  after it in the same transaction
+#define LSM303AGR_ACC_AUTO_INCREMENT 0x80
+
 // Measurement data type
 typedef struct {
   float x_axis;
@@ -7,12 +7,18 @@
 #include <stdio.h>
 #include <math.h>
 
+#include "nrf.h"
 #include "nrf_delay.h"
 #include "nrf_twi_mngr.h"
 
 #include "microbit_v2.h"
 #include "lsm303agr.h"
 
+// I2C bus speed: NRF_TWIM_FREQ_100K or NRF_TWIM_FREQ_400K
+#ifndef I2C_FREQUENCY
+#define I2C_FREQUENCY NRF_TWIM_FREQ_100K
+#endif
+
 // Global variables
 NRF_TWI_MNGR_DEF(twi_mngr_instance, 1, 0);
 
@@ -23,16 +29,31 @@ int main(void) {
   nrf_drv_twi_config_t i2c_config = NRF_DRV_TWI_DEFAULT_CONFIG;
   i2c_config.scl = I2C_SCL;
   i2c_config.sda = I2C_SDA;
-  i2c_config.frequency = NRF_TWIM_FREQ_100K;
+  i2c_config.frequency = I2C_FREQUENCY;
   nrf_twi_mngr_init(&twi_mngr_instance, &i2c_config);
 
   // Initialize the LSM303AGR accelerometer/magnetometer sensor
   lsm303agr_init(&twi_mngr_instance);
 
+  // count CPU cycles for timing reads
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
   // Loop forever
   while (1) {
     // Print output
-    //TODO: implement me!
+    uint32_t start = DWT->CYCCNT;
+    lsm303agr_measurement_t acc = lsm303agr_read_accelerometer();
+    uint32_t acc_cycles = DWT->CYCCNT - start;
+
+    start = DWT->CYCCNT;
+    lsm303agr_measurement_t mag = lsm303agr_read_magnetometer();
+    uint32_t mag_cycles = DWT->CYCCNT - start;
+
+    printf("Acceleration: %f, %f, %f g (read in %lu us)\n",
+        acc.x_axis, acc.y_axis, acc.z_axis, acc_cycles / 64);
+    printf("Magnetic field: %f, %f, %f uT (read in %lu us)\n",
+        mag.x_axis, mag.y_axis, mag.z_axis, mag_cycles / 64);
 
     nrf_delay_ms(1000);
   }
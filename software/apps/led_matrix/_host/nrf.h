@@ -0,0 +1,90 @@
+// Host stand-in for the nRF SDK's "nrf.h"
+//
+// Enough to compile the LED matrix driver on a Linux machine. The peripherals
+//  it uses are simulated by sim_nrf.c, which must be linked in
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// -- Peripherals
+
+typedef struct {
+  volatile uint32_t OUT;
+  volatile uint32_t OUTSET;
+  volatile uint32_t OUTCLR;
+  volatile uint32_t IN;
+  volatile uint32_t DIR;
+  volatile uint32_t DIRSET;
+  volatile uint32_t DIRCLR;
+  volatile uint32_t LATCH;
+  volatile uint32_t DETECTMODE;
+  volatile uint32_t PIN_CNF[32];
+} NRF_GPIO_Type;
+
+typedef struct {
+  volatile uint32_t TASKS_START;
+  volatile uint32_t TASKS_STOP;
+  volatile uint32_t TASKS_COUNT;
+  volatile uint32_t TASKS_CLEAR;
+  volatile uint32_t TASKS_CAPTURE[6];
+  volatile uint32_t EVENTS_COMPARE[6];
+  volatile uint32_t SHORTS;
+  volatile uint32_t INTENSET;
+  volatile uint32_t INTENCLR;
+  volatile uint32_t MODE;
+  volatile uint32_t BITMODE;
+  volatile uint32_t PRESCALER;
+  volatile uint32_t CC[6];
+} NRF_TIMER_Type;
+
+typedef struct {
+  volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t CYCCNT;
+} DWT_Type;
+
+// Every access to a simulated peripheral goes through one of these, which
+//  records pin changes and timer writes since the last access and moves the
+//  simulated clock
+NRF_GPIO_Type* sim_gpio(uint32_t port);
+NRF_TIMER_Type* sim_timer3(void);
+DWT_Type* sim_dwt(void);
+extern CoreDebug_Type sim_core_debug;
+
+#define NRF_P0 (sim_gpio(0))
+#define NRF_P1 (sim_gpio(1))
+#define NRF_TIMER3 (sim_timer3())
+#define DWT (sim_dwt())
+#define CoreDebug (&sim_core_debug)
+
+#define TIMER_MODE_MODE_Timer 0
+#define TIMER_BITMODE_BITMODE_32Bit 3
+#define TIMER_SHORTS_COMPARE0_CLEAR_Msk (1u << 0)
+#define TIMER_INTENSET_COMPARE0_Msk (1u << 16)
+#define CoreDebug_DEMCR_TRCENA_Msk (1u << 24)
+#define DWT_CTRL_CYCCNTENA_Msk 1u
+
+
+// -- Interrupts
+
+typedef enum {
+  TIMER3_IRQn = 26,
+} IRQn_Type;
+
+void TIMER3_IRQHandler(void);
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+
+// Sleeps until the next interrupt has run
+void __WFE(void);
+
+static inline void __DMB(void) {
+  __asm__ volatile ("" ::: "memory");
+}
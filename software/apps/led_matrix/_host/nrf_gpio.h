@@ -0,0 +1,29 @@
+// Host stand-in for the nRF SDK's "nrf_gpio.h"
+//
+// Only what microbit_v2.h and led_matrix.c use, written on top of the
+//  simulated ports
+
+#pragma once
+
+#include <stdint.h>
+
+#include "nrf.h"
+
+#define NRF_GPIO_PIN_MAP(port, pin) (((port) << 5) | ((pin) & 0x1F))
+
+static inline NRF_GPIO_Type* nrf_gpio_port(uint32_t pin) {
+  return (pin >> 5) ? NRF_P1 : NRF_P0;
+}
+
+static inline void nrf_gpio_pin_set(uint32_t pin) {
+  nrf_gpio_port(pin)->OUTSET = 1u << (pin & 0x1F);
+}
+
+static inline void nrf_gpio_pin_clear(uint32_t pin) {
+  nrf_gpio_port(pin)->OUTCLR = 1u << (pin & 0x1F);
+}
+
+static inline void nrf_gpio_cfg_output(uint32_t pin) {
+  // DIR output, input buffer disconnected
+  nrf_gpio_port(pin)->PIN_CNF[pin & 0x1F] = 3;
+}
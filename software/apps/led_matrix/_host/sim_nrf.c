@@ -0,0 +1,292 @@
+// Simulated nRF52833 peripherals for the LED matrix host build
+//
+// Writes to a peripheral are picked up at the next access to any simulated
+//  peripheral, or when a handler returns, and take effect at that time. The
+//  timer counts in 16 MHz ticks from the time it was last started or
+//  cleared, so its compare events land exactly where the hardware's would.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "sim_nrf.h"
+
+#define TICK_PS 62500ull
+#define CYCLE_PS 15625ull
+#define NEVER UINT64_MAX
+
+// 12 cycles from the event to the first instruction of the handler
+#define INTERRUPT_ENTRY_PS (12 * CYCLE_PS)
+
+static NRF_GPIO_Type gpio[2];
+static uint32_t gpio_out_seen[2];
+
+static NRF_TIMER_Type timer3;
+static bool timer_running;
+// when the counter was 0, while running, or its value while stopped
+static uint64_t timer_zero_ps;
+static uint32_t timer_stopped_count;
+static uint32_t timer_cc_seen;
+// when CC[0] last changed, and when it last matched
+static uint64_t timer_cc_written_ps;
+static uint64_t timer_last_event_ps;
+// CC[0] was written after the counter passed it, and the timer has not been
+//  cleared since
+static bool timer_cc_late;
+
+static DWT_Type dwt;
+CoreDebug_Type sim_core_debug;
+
+static bool irq_enabled;
+static bool in_handler;
+
+static uint64_t now_ps;
+static uint64_t access_cost_ps = 50000;
+static uint64_t interrupt_latency_ps = 0;
+
+static sim_gpio_listener_t gpio_listener = NULL;
+static sim_counts_t counts;
+
+
+// -- Peripheral state
+
+static uint32_t timer_count(uint64_t time_ps) {
+  if (!timer_running) {
+    return timer_stopped_count;
+  }
+  return (uint32_t)((time_ps - timer_zero_ps) / TICK_PS);
+}
+
+// Apply everything written since the last poll
+static void poll(void) {
+  for (uint32_t port = 0; port < 2; port++) {
+    NRF_GPIO_Type* p = &gpio[port];
+    if (p->OUTSET) {
+      p->OUT |= p->OUTSET;
+      p->OUTSET = 0;
+    }
+    if (p->OUTCLR) {
+      p->OUT &= ~p->OUTCLR;
+      p->OUTCLR = 0;
+    }
+    if (p->OUT != gpio_out_seen[port]) {
+      counts.pin_transitions += __builtin_popcount(p->OUT ^ gpio_out_seen[port]);
+      gpio_out_seen[port] = p->OUT;
+      if (gpio_listener != NULL) {
+        gpio_listener(now_ps, gpio[0].OUT, gpio[1].OUT);
+      }
+    }
+  }
+
+  if (timer3.TASKS_STOP) {
+    timer3.TASKS_STOP = 0;
+    timer_stopped_count = timer_count(now_ps);
+    timer_running = false;
+  }
+  if (timer3.TASKS_CLEAR) {
+    timer3.TASKS_CLEAR = 0;
+    timer_zero_ps = now_ps;
+    timer_stopped_count = 0;
+    if (timer_cc_late) {
+      counts.recovered_compares++;
+      timer_cc_late = false;
+    }
+  }
+  if (timer3.TASKS_START) {
+    timer3.TASKS_START = 0;
+    if (!timer_running) {
+      timer_running = true;
+      timer_zero_ps = now_ps - (uint64_t)timer_stopped_count * TICK_PS;
+    }
+  }
+  for (uint32_t channel = 0; channel < 6; channel++) {
+    if (timer3.TASKS_CAPTURE[channel]) {
+      timer3.TASKS_CAPTURE[channel] = 0;
+      timer3.CC[channel] = timer_count(now_ps);
+    }
+  }
+  if (timer3.INTENCLR) {
+    timer3.INTENSET &= ~timer3.INTENCLR;
+    timer3.INTENCLR = 0;
+  }
+  if (timer3.CC[0] != timer_cc_seen) {
+    if (timer_running && timer3.CC[0] <= timer_count(now_ps)) {
+      timer_cc_late = true;
+    }
+    timer_cc_seen = timer3.CC[0];
+    timer_cc_written_ps = now_ps;
+  }
+
+  dwt.CYCCNT = (uint32_t)(now_ps / CYCLE_PS);
+}
+
+static void access(void) {
+  poll();
+  now_ps += access_cost_ps;
+}
+
+// Time of the next COMPARE[0] event, or NEVER
+static uint64_t next_compare(void) {
+  if (!timer_running || timer3.PRESCALER != 0) {
+    return NEVER;
+  }
+
+  // The match can be in the past if a handler ran long, but only if CC[0]
+  //  already held this value then. Otherwise the counter went past it first,
+  //  and the next match is after the 32-bit counter wraps
+  uint64_t match_ps = timer_zero_ps + (uint64_t)timer3.CC[0] * TICK_PS;
+  if (match_ps < timer_cc_written_ps || match_ps <= timer_last_event_ps) {
+    return NEVER;
+  }
+  return match_ps;
+}
+
+static void run_handler(void) {
+  in_handler = true;
+  now_ps += INTERRUPT_ENTRY_PS + interrupt_latency_ps;
+  counts.interrupts++;
+  TIMER3_IRQHandler();
+  poll();
+  in_handler = false;
+
+  // a late compare value the handler did not recover from
+  if (timer_cc_late) {
+    counts.missed_compares++;
+    timer_cc_late = false;
+  }
+
+  if (timer3.EVENTS_COMPARE[0]) {
+    counts.uncleared_events++;
+    timer3.EVENTS_COMPARE[0] = 0;
+  }
+}
+
+// Run until <end_ps>, or until one handler has run if <one_interrupt>
+static void run_until(uint64_t end_ps, bool one_interrupt) {
+  while (true) {
+    poll();
+    uint64_t event_ps = next_compare();
+    if (event_ps == NEVER && one_interrupt) {
+      fprintf(stderr, "ERROR: waiting for an interrupt that will never come\n");
+      exit(1);
+    }
+    if (event_ps > end_ps) {
+      if (now_ps < end_ps) {
+        now_ps = end_ps;
+      }
+      poll();
+      return;
+    }
+
+    // the event and the clear happen on time, even if the handler for the
+    //  last one is still running
+    timer3.EVENTS_COMPARE[0] = 1;
+    timer_last_event_ps = event_ps;
+    if (timer3.SHORTS & TIMER_SHORTS_COMPARE0_CLEAR_Msk) {
+      timer_zero_ps = event_ps;
+    }
+    if (event_ps > now_ps) {
+      now_ps = event_ps;
+    }
+
+    if (irq_enabled && (timer3.INTENSET & TIMER_INTENSET_COMPARE0_Msk) && !in_handler) {
+      run_handler();
+      if (one_interrupt) {
+        return;
+      }
+    }
+  }
+}
+
+
+// -- Register access
+
+NRF_GPIO_Type* sim_gpio(uint32_t port) {
+  access();
+  return &gpio[port];
+}
+
+NRF_TIMER_Type* sim_timer3(void) {
+  access();
+  return &timer3;
+}
+
+DWT_Type* sim_dwt(void) {
+  access();
+  return &dwt;
+}
+
+
+// -- CMSIS
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+  access();
+  irq_enabled = true;
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+  access();
+  irq_enabled = false;
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq) {
+  access();
+}
+
+void __WFE(void) {
+  if (in_handler) {
+    fprintf(stderr, "ERROR: __WFE() called from the interrupt handler\n");
+    exit(1);
+  }
+  run_until(NEVER, true);
+}
+
+
+// -- Simulation control
+
+void sim_reset(void) {
+  memset(gpio, 0, sizeof(gpio));
+  memset(gpio_out_seen, 0, sizeof(gpio_out_seen));
+  memset(&timer3, 0, sizeof(timer3));
+  memset(&dwt, 0, sizeof(dwt));
+  memset(&sim_core_debug, 0, sizeof(sim_core_debug));
+  memset(&counts, 0, sizeof(counts));
+  timer_running = false;
+  timer_zero_ps = 0;
+  timer_stopped_count = 0;
+  timer_cc_seen = 0;
+  timer_cc_written_ps = 0;
+  timer_last_event_ps = 0;
+  timer_cc_late = false;
+  interrupt_latency_ps = 0;
+  irq_enabled = false;
+  in_handler = false;
+  now_ps = 0;
+}
+
+uint64_t sim_time_ps(void) {
+  return now_ps;
+}
+
+void sim_run(uint64_t picoseconds) {
+  run_until(now_ps + picoseconds, false);
+}
+
+void sim_set_access_cost(uint64_t picoseconds) {
+  access_cost_ps = picoseconds;
+}
+
+void sim_set_interrupt_latency(uint64_t picoseconds) {
+  interrupt_latency_ps = picoseconds;
+}
+
+void sim_set_gpio_listener(sim_gpio_listener_t listener) {
+  gpio_listener = listener;
+}
+
+void sim_get_counts(sim_counts_t* out) {
+  *out = counts;
+}
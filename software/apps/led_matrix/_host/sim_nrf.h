@@ -0,0 +1,60 @@
+// Simulated nRF52833 peripherals for the LED matrix host build
+//
+// P0, P1, TIMER3, the DWT cycle counter and the TIMER3 interrupt are
+//  simulated well enough to run led_matrix.c unmodified. Time is kept in
+//  picoseconds and only moves when asked to, or by a fixed cost per
+//  peripheral access, so every run is deterministic.
+//
+// Interrupt handlers only run inside sim_run() and __WFE(). Code outside a
+//  handler is not preempted, and takes no time unless it touches a
+//  peripheral.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "nrf.h"
+
+#define SIM_PS_PER_US 1000000ull
+
+// Called whenever a port output changes, with the new values of both ports
+typedef void (*sim_gpio_listener_t)(uint64_t time_ps, uint32_t p0_out, uint32_t p1_out);
+
+typedef struct {
+  // pins that changed level
+  uint64_t pin_transitions;
+  // times the TIMER3 handler ran
+  uint64_t interrupts;
+  // compare values written after the counter had already passed them, and
+  //  not followed by a clear in the same handler. On hardware this stalls the
+  //  display until the counter wraps
+  uint32_t missed_compares;
+  // compare values written too late, after which the handler cleared the
+  //  timer so the next compare still matches
+  uint32_t recovered_compares;
+  // handlers that returned without clearing the compare event
+  uint32_t uncleared_events;
+} sim_counts_t;
+
+// Reset every simulated peripheral and set the time to 0
+void sim_reset(void);
+
+// Current simulated time in picoseconds
+uint64_t sim_time_ps(void);
+
+// Move simulated time forward, running the TIMER3 handler whenever its
+//  compare event fires
+void sim_run(uint64_t picoseconds);
+
+// Set how long each peripheral access takes, in picoseconds
+void sim_set_access_cost(uint64_t picoseconds);
+
+// Delay every TIMER3 handler by this much more than the interrupt entry, as
+//  if a higher priority interrupt held it off
+void sim_set_interrupt_latency(uint64_t picoseconds);
+
+// Set the function told about port output changes
+void sim_set_gpio_listener(sim_gpio_listener_t listener);
+
+// Get the counts since sim_reset()
+void sim_get_counts(sim_counts_t* counts);
@@ -0,0 +1,294 @@
+// LED matrix simulator test
+//
+// Runs led_matrix.c against the simulated ports and TIMER3, and watches the
+//  row and column pins the way an eye would: every pin change is timestamped,
+//  and the time each LED spends lit is added up over many frames. Each test
+//  draws an image, lets the display settle, and then checks:
+//  - the perceived brightness of every pixel against the image, to within
+//    the rounding of the bit depth
+//  - ghosting: time any pixel that should be dark spends lit
+//  - the on-time of each row and the refresh rate
+//  - that the timer never missed a compare value, even when the handler is
+//    held off for longer than the shortest slice
+//
+// Built once per bit depth (see the Makefile). Exits with status 1 on failure.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nrf.h"
+#include "sim_nrf.h"
+
+#include "font.h"
+#include "led_matrix.h"
+#include "marquee.h"
+#include "microbit_v2.h"
+
+#define FRAME_PS ((uint64_t)LED_MATRIX_ROW_US * LED_MATRIX_ROWS * SIM_PS_PER_US)
+#define SETTLE_FRAMES 3
+#define MEASURE_FRAMES 200
+// 50 seconds of display time, inside the 67 seconds before the cycle counter
+//  used for the handler statistics wraps
+#define BENCHMARK_FRAMES 10000
+
+// Handler delay for test_late_handler(), longer than
+//  LED_MATRIX_MIN_SLICE_TICKS
+#define LATE_HANDLER_US 10
+
+// Largest perceived brightness error, as a fraction of full brightness. Covers
+//  the minimum slice length and the time the handler takes to switch pins
+#define TOLERANCE 0.02
+
+static const uint8_t row_pins[LED_MATRIX_ROWS] = {LED_ROW1, LED_ROW2, LED_ROW3, LED_ROW4, LED_ROW5};
+static const uint8_t col_pins[LED_MATRIX_COLS] = {LED_COL1, LED_COL2, LED_COL3, LED_COL4, LED_COL5};
+
+static bool failed = false;
+
+
+// -- Eye model
+
+typedef struct {
+  bool measuring;
+  uint64_t start_ps;
+  uint64_t last_ps;
+  uint32_t ports[2];
+  uint64_t pixel_ps[LED_MATRIX_ROWS][LED_MATRIX_COLS];
+  uint64_t row_ps[LED_MATRIX_ROWS];
+  uint64_t ghost_ps;
+  uint32_t frames;
+  // pixels that should be dark
+  bool dark[LED_MATRIX_ROWS][LED_MATRIX_COLS];
+} eye_t;
+
+static eye_t eye;
+
+static bool pin_high(const uint32_t* ports, uint8_t pin) {
+  return (ports[pin >> 5] >> (pin & 0x1F)) & 1;
+}
+
+// Credit the time since the last change to whatever was lit
+static void eye_accumulate(uint64_t time_ps) {
+  uint64_t elapsed = time_ps - eye.last_ps;
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    if (!pin_high(eye.ports, row_pins[row])) {
+      continue;
+    }
+    eye.row_ps[row] += elapsed;
+    for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+      if (!pin_high(eye.ports, col_pins[col])) {
+        eye.pixel_ps[row][col] += elapsed;
+        if (eye.dark[row][col]) {
+          eye.ghost_ps += elapsed;
+        }
+      }
+    }
+  }
+  eye.last_ps = time_ps;
+}
+
+static void eye_pins_changed(uint64_t time_ps, uint32_t p0_out, uint32_t p1_out) {
+  if (eye.measuring) {
+    eye_accumulate(time_ps);
+
+    // a frame starts each time the first row turns on
+    if (!pin_high(eye.ports, row_pins[0]) && ((p0_out >> (row_pins[0] & 0x1F)) & 1)) {
+      eye.frames++;
+    }
+  }
+  eye.ports[0] = p0_out;
+  eye.ports[1] = p1_out;
+}
+
+// Intensity the driver can show for <intensity> at full brightness, 0 to 1
+static double shown_level(uint8_t intensity) {
+  uint32_t levels = (1u << LED_MATRIX_BITS) - 1;
+  return (double)(intensity >> (8 - LED_MATRIX_BITS)) / levels;
+}
+
+static void eye_start(const uint8_t image[LED_MATRIX_ROWS][LED_MATRIX_COLS]) {
+  uint32_t ports[2] = {eye.ports[0], eye.ports[1]};
+  memset(&eye, 0, sizeof(eye));
+  eye.ports[0] = ports[0];
+  eye.ports[1] = ports[1];
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+      eye.dark[row][col] = shown_level(image[row][col]) == 0;
+    }
+  }
+  eye.start_ps = sim_time_ps();
+  eye.last_ps = eye.start_ps;
+  eye.measuring = true;
+}
+
+// Check what the eye saw against <image> shown at <brightness>
+static void eye_check(const char* name, const uint8_t image[LED_MATRIX_ROWS][LED_MATRIX_COLS],
+    uint8_t brightness) {
+  eye_accumulate(sim_time_ps());
+  eye.measuring = false;
+  double elapsed = (double)(eye.last_ps - eye.start_ps);
+
+  // a pixel on for its whole row is 1
+  double max_error = 0;
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+      double seen = eye.pixel_ps[row][col] * LED_MATRIX_ROWS / elapsed;
+      double expected = shown_level(image[row][col]) * brightness / 255.0;
+      double error = seen > expected ? seen - expected : expected - seen;
+      if (error > max_error) {
+        max_error = error;
+      }
+    }
+  }
+
+  double refresh_hz = eye.frames * 1e12 / elapsed;
+  printf("%-12s refresh %6.1f Hz, row on-time", name, refresh_hz);
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    printf(" %4.1f%%", eye.row_ps[row] * 100.0 / elapsed);
+  }
+  printf(", max error %.4f, ghosting %.0f ns\n", max_error, eye.ghost_ps / 1000.0);
+
+  if (max_error > TOLERANCE) {
+    printf("ERROR: %s: perceived brightness is off by %.4f\n", name, max_error);
+    failed = true;
+  }
+  if (eye.ghost_ps != 0) {
+    printf("ERROR: %s: dark pixels were lit\n", name);
+    failed = true;
+  }
+}
+
+
+// -- Tests
+
+static void draw_image(const uint8_t image[LED_MATRIX_ROWS][LED_MATRIX_COLS]) {
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+      led_matrix_set_intensity(row, col, image[row][col]);
+    }
+  }
+}
+
+// Show <image>, let it settle, and watch it
+static void test_image(const char* name, const uint8_t image[LED_MATRIX_ROWS][LED_MATRIX_COLS],
+    uint8_t brightness) {
+  led_matrix_set_brightness(brightness);
+  draw_image(image);
+  led_matrix_swap();
+  sim_run(SETTLE_FRAMES * FRAME_PS);
+
+  eye_start(image);
+  sim_run(MEASURE_FRAMES * FRAME_PS);
+  eye_check(name, image, brightness);
+}
+
+// Scroll a character in with the marquee and check it ends up whole
+static void test_marquee(void) {
+  marquee_start("A");
+  for (uint8_t step = 0; step < LED_MATRIX_COLS; step++) {
+    marquee_step();
+    sim_run(2 * FRAME_PS);
+  }
+  sim_run(SETTLE_FRAMES * FRAME_PS);
+
+  uint8_t image[LED_MATRIX_ROWS][LED_MATRIX_COLS];
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+      image[row][col] = ((font['A'][row] >> col) & 1) ? 255 : 0;
+    }
+  }
+  eye_start(image);
+  sim_run(MEASURE_FRAMES * FRAME_PS);
+  eye_check("marquee", image, 255);
+}
+
+// Hold every handler off for longer than the shortest slice. The compare
+//  values it writes are then already passed, and the handler has to restart
+//  the slice or the display stalls until the counter wraps. Brightness is not
+//  checked, since late slices run long
+static void test_late_handler(void) {
+  sim_counts_t before;
+  sim_get_counts(&before);
+  led_matrix_isr_stats_reset();
+
+  led_matrix_set_brightness(1);
+  sim_set_interrupt_latency(LATE_HANDLER_US * SIM_PS_PER_US);
+  sim_run(MEASURE_FRAMES * FRAME_PS);
+  sim_set_interrupt_latency(0);
+  led_matrix_set_brightness(255);
+
+  sim_counts_t after;
+  sim_get_counts(&after);
+  led_matrix_isr_stats_t stats;
+  led_matrix_get_isr_stats(&stats);
+  printf("late handler: %u slices restarted, %u frames\n",
+      after.recovered_compares - before.recovered_compares, stats.frames);
+  if (after.recovered_compares == before.recovered_compares) {
+    printf("ERROR: no compare values were written late, the test did nothing\n");
+    failed = true;
+  }
+  if (stats.frames < MEASURE_FRAMES / 2) {
+    printf("ERROR: only %u frames were shown while handlers were late\n", stats.frames);
+    failed = true;
+  }
+}
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+  printf("LED matrix simulator, %u-bit\n", LED_MATRIX_BITS);
+  sim_reset();
+  sim_set_gpio_listener(eye_pins_changed);
+  led_matrix_init();
+
+  uint8_t image[LED_MATRIX_ROWS][LED_MATRIX_COLS];
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+      image[row][col] = ((row + col) % 2) ? 255 : 0;
+    }
+  }
+  test_image("checkerboard", image, 255);
+  test_image("dimmed", image, 64);
+
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+      image[row][col] = (row * LED_MATRIX_COLS + col) * 255 / 24;
+    }
+  }
+  test_image("gradient", image, 255);
+
+  test_marquee();
+  test_late_handler();
+
+  // refresh as fast as the simulator goes
+  led_matrix_isr_stats_reset();
+  double start = seconds();
+  sim_run(BENCHMARK_FRAMES * FRAME_PS);
+  double elapsed = seconds() - start;
+  printf("%u frames simulated in %.2f s, %.0f frames per second\n",
+      BENCHMARK_FRAMES, elapsed, BENCHMARK_FRAMES / elapsed);
+  led_matrix_isr_stats_print();
+
+  sim_counts_t counts;
+  sim_get_counts(&counts);
+  printf("%llu interrupts, %llu pin transitions\n",
+      (unsigned long long)counts.interrupts, (unsigned long long)counts.pin_transitions);
+  if (counts.missed_compares != 0) {
+    printf("ERROR: %u compare values were written too late\n", counts.missed_compares);
+    failed = true;
+  }
+  if (counts.uncleared_events != 0) {
+    printf("ERROR: the handler left the compare event set %u times\n", counts.uncleared_events);
+    failed = true;
+  }
+
+  printf(failed ? "FAILED\n" : "PASSED\n");
+  return failed ? 1 : 0;
+}
@@ -3,7 +3,7 @@
 
 #include "font.h"
 
-uint8_t font[128][5] = {
+const uint8_t font[128][5] = {
     {0x00,0x00,0x00,0x00,0x00,},
     {0x00,0x00,0x00,0x00,0x00,},
     {0x00,0x00,0x00,0x00,0x00,},
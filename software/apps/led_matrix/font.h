@@ -2,5 +2,9 @@
 
 #include <stdint.h>
 
-extern uint8_t font[128][5];
+// One byte per row, top to bottom. Bit 0 is the leftmost column
+extern const uint8_t font[128][5];
 
+// The same glyphs one byte per column, left to right. Bit 0 is the top row
+// Generated from font.c by font_transpose.py
+extern const uint8_t font_columns[128][5];
@@ -0,0 +1,135 @@
+// 5x5 Font, one byte per column
+// Generated from font.c by font_transpose.py. Do not edit
+
+#include "font.h"
+
+const uint8_t font_columns[128][5] = {
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x00,0x00,0x00,},
+    {0x00,0x00,0x17,0x00,0x00,},
+    {0x00,0x03,0x00,0x03,0x00,},
+    {0x0A,0x1F,0x0A,0x1F,0x0A,},
+    {0x12,0x15,0x1F,0x15,0x09,},
+    {0x13,0x0B,0x04,0x1A,0x19,},
+    {0x00,0x0A,0x15,0x0A,0x10,},
+    {0x00,0x02,0x01,0x00,0x00,},
+    {0x00,0x00,0x0E,0x11,0x00,},
+    {0x00,0x00,0x11,0x0E,0x00,},
+    {0x15,0x0E,0x1F,0x0E,0x15,},
+    {0x00,0x04,0x0E,0x04,0x00,},
+    {0x00,0x10,0x08,0x00,0x00,},
+    {0x00,0x04,0x04,0x04,0x00,},
+    {0x00,0x00,0x10,0x00,0x00,},
+    {0x10,0x08,0x04,0x02,0x01,},
+    {0x0E,0x19,0x15,0x13,0x0E,},
+    {0x00,0x12,0x1F,0x10,0x00,},
+    {0x00,0x12,0x19,0x15,0x12,},
+    {0x00,0x11,0x15,0x0A,0x00,},
+    {0x00,0x06,0x05,0x1F,0x04,},
+    {0x00,0x17,0x15,0x09,0x00,},
+    {0x0C,0x16,0x15,0x08,0x00,},
+    {0x00,0x01,0x19,0x05,0x03,},
+    {0x0A,0x15,0x15,0x0A,0x00,},
+    {0x02,0x05,0x05,0x1E,0x00,},
+    {0x00,0x00,0x0A,0x00,0x00,},
+    {0x00,0x10,0x0A,0x00,0x00,},
+    {0x00,0x04,0x0A,0x11,0x00,},
+    {0x00,0x0A,0x0A,0x0A,0x00,},
+    {0x00,0x11,0x0A,0x04,0x00,},
+    {0x00,0x01,0x15,0x02,0x00,},
+    {0x08,0x15,0x1D,0x11,0x0E,},
+    {0x1E,0x05,0x05,0x05,0x1E,},
+    {0x1F,0x15,0x15,0x15,0x0A,},
+    {0x0E,0x11,0x11,0x11,0x11,},
+    {0x1F,0x11,0x11,0x11,0x0E,},
+    {0x1F,0x15,0x15,0x15,0x11,},
+    {0x1F,0x05,0x05,0x05,0x01,},
+    {0x0E,0x11,0x11,0x15,0x1D,},
+    {0x1F,0x04,0x04,0x04,0x1F,},
+    {0x00,0x11,0x1F,0x11,0x00,},
+    {0x08,0x10,0x11,0x0F,0x01,},
+    {0x1F,0x04,0x0A,0x11,0x00,},
+    {0x1F,0x10,0x10,0x10,0x00,},
+    {0x1F,0x02,0x04,0x02,0x1F,},
+    {0x1F,0x02,0x04,0x08,0x1F,},
+    {0x0E,0x11,0x11,0x11,0x0E,},
+    {0x1F,0x05,0x05,0x05,0x02,},
+    {0x0E,0x11,0x11,0x09,0x16,},
+    {0x1F,0x05,0x0D,0x15,0x02,},
+    {0x12,0x15,0x15,0x15,0x09,},
+    {0x01,0x01,0x1F,0x01,0x01,},
+    {0x0F,0x10,0x10,0x10,0x0F,},
+    {0x07,0x08,0x10,0x08,0x07,},
+    {0x0F,0x10,0x0C,0x10,0x0F,},
+    {0x11,0x0A,0x04,0x0A,0x11,},
+    {0x01,0x02,0x1C,0x02,0x01,},
+    {0x00,0x19,0x15,0x13,0x00,},
+    {0x00,0x1F,0x11,0x11,0x00,},
+    {0x01,0x02,0x04,0x08,0x10,},
+    {0x00,0x11,0x11,0x1F,0x00,},
+    {0x00,0x02,0x01,0x02,0x00,},
+    {0x10,0x10,0x10,0x10,0x10,},
+    {0x00,0x00,0x01,0x02,0x00,},
+    {0x0C,0x12,0x12,0x0E,0x10,},
+    {0x1F,0x12,0x12,0x0C,0x00,},
+    {0x00,0x0C,0x12,0x12,0x00,},
+    {0x08,0x14,0x14,0x1F,0x00,},
+    {0x00,0x0C,0x1A,0x14,0x00,},
+    {0x00,0x04,0x1E,0x05,0x00,},
+    {0x00,0x12,0x15,0x0F,0x00,},
+    {0x00,0x1F,0x04,0x04,0x18,},
+    {0x00,0x00,0x1D,0x00,0x00,},
+    {0x00,0x08,0x10,0x0D,0x00,},
+    {0x00,0x1F,0x08,0x14,0x00,},
+    {0x00,0x00,0x1F,0x00,0x00,},
+    {0x1E,0x02,0x04,0x02,0x1C,},
+    {0x00,0x1E,0x02,0x1C,0x00,},
+    {0x00,0x0C,0x12,0x0C,0x00,},
+    {0x00,0x1E,0x0A,0x04,0x00,},
+    {0x00,0x04,0x0A,0x1E,0x00,},
+    {0x00,0x1E,0x04,0x02,0x00,},
+    {0x00,0x00,0x16,0x1A,0x00,},
+    {0x00,0x02,0x0E,0x12,0x00,},
+    {0x00,0x0E,0x10,0x10,0x0E,},
+    {0x00,0x0E,0x10,0x0E,0x00,},
+    {0x0E,0x10,0x0C,0x10,0x0E,},
+    {0x00,0x12,0x0C,0x12,0x00,},
+    {0x00,0x16,0x08,0x06,0x00,},
+    {0x00,0x00,0x1A,0x16,0x00,},
+    {0x00,0x04,0x0E,0x11,0x00,},
+    {0x00,0x00,0x1B,0x00,0x00,},
+    {0x00,0x11,0x0E,0x04,0x00,},
+    {0x04,0x02,0x04,0x02,0x00,},
+    {0x1F,0x11,0x11,0x11,0x1F,},
+};
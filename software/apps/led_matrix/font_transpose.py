@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""Generate font_columns.c, a column-major copy of the font in font.c.
+
+font.c stores each glyph as five row bytes with bit 0 as the leftmost column.
+Scrolling text sideways needs one column at a time, so this writes each glyph
+as five column bytes with bit 0 as the top row.
+
+Usage: font_transpose.py font.c > font_columns.c
+"""
+
+import re
+import sys
+
+ROWS = 5
+COLS = 5
+
+
+def read_font(path):
+    with open(path) as f:
+        source = f.read()
+
+    body = source[source.index("font[128][5]"):]
+    glyphs = re.findall(r"\{\s*((?:0x[0-9A-Fa-f]+\s*,\s*){%d})\}" % ROWS, body)
+    if len(glyphs) != 128:
+        sys.exit("expected 128 glyphs in %s, found %d" % (path, len(glyphs)))
+    return [[int(value, 16) for value in re.findall(r"0x[0-9A-Fa-f]+", glyph)] for glyph in glyphs]
+
+
+def transpose(rows):
+    columns = []
+    for col in range(COLS):
+        bits = 0
+        for row in range(ROWS):
+            if rows[row] & (1 << col):
+                bits |= 1 << row
+        columns.append(bits)
+    return columns
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: font_transpose.py font.c > font_columns.c")
+
+    font = read_font(sys.argv[1])
+    print("// 5x5 Font, one byte per column")
+    print("// Generated from font.c by font_transpose.py. Do not edit")
+    print("")
+    print('#include "font.h"')
+    print("")
+    print("const uint8_t font_columns[128][5] = {")
+    for glyph in font:
+        print("    {" + "".join("0x%02X," % bits for bits in transpose(glyph)) + "},")
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
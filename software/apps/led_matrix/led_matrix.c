@@ -1,27 +1,546 @@
 // LED Matrix Driver
 // Displays characters on the LED matrix
+//
+// Drawing happens in a separate back buffer, which led_matrix_swap() converts
+//  to whatever the refresh driver reads and hands over at the start of a
+//  frame, so frames are never torn. The application never touches the pins.
+//
+// TIMER driver: TIMER3 interrupts once per time slice. Each row is shown for
+//  LED_MATRIX_BITS slices with binary code modulation: the slice for bit k
+//  lasts 2^k base times, and a pixel is lit in the slices for the bits set in
+//  its intensity. A last dark slice pads the row for the global brightness.
+//  Each frame is kept as the value every port needs in each slice, so the
+//  handler only has to write one word per port.
+//
+// PWM driver: each of the 10 matrix pins is one channel of PWM0-2, with one
+//  PWM period per row. The PWMs play the frame from RAM with EasyDMA and
+//  restart it themselves, so refreshing takes no CPU time and works while the
+//  CPU sleeps. Column duty cycles give grayscale.
 
 #include <stdbool.h>
 #include <stdio.h>
 
+#include "nrf.h"
 #include "nrf_gpio.h"
-#include "app_timer.h"
 
 #include "led_matrix.h"
 #include "font.h"
 #include "microbit_v2.h"
 
+static const uint8_t row_pins[LED_MATRIX_ROWS] = {LED_ROW1, LED_ROW2, LED_ROW3, LED_ROW4, LED_ROW5};
+static const uint8_t col_pins[LED_MATRIX_COLS] = {LED_COL1, LED_COL2, LED_COL3, LED_COL4, LED_COL5};
+
+// Back buffer, one intensity per pixel
+static uint8_t back_buffer[LED_MATRIX_ROWS][LED_MATRIX_COLS];
+
+static uint32_t stats_start_cycles = 0;
+
+static inline uint32_t pin_bit(uint8_t pin) {
+  return 1u << (pin & 0x1F);
+}
+
+
+#if LED_MATRIX_DRIVER == LED_MATRIX_DRIVER_TIMER
+
+// -- TIMER driver
+
+#if LED_MATRIX_BITS < 1 || LED_MATRIX_BITS > 8
+#error "LED_MATRIX_BITS must be from 1 to 8"
+#endif
+
+#define PORTS 2
+#define ROW_TIMER NRF_TIMER3
+#define ROW_TIMER_IRQn TIMER3_IRQn
+
+// 16 MHz row timer
+#define ROW_TICKS (LED_MATRIX_ROW_US * 16)
+
+// Bit slices plus the dark slice
+#define SLICES (LED_MATRIX_BITS + 1)
+#define DARK_SLICE LED_MATRIX_BITS
+
+// Matrix pins each port drives high and low in one slice, written with OUTSET
+//  and OUTCLR so the other pins on the port are left alone. Rows are all on
+//  P0, so the P0 clear turns the old row off and the P0 set turns the new row
+//  on. The P1 columns are written in between, while no row is lit
+typedef struct {
+  uint32_t set[PORTS];
+  uint32_t clear[PORTS];
+} slice_words_t;
+
+typedef struct {
+  slice_words_t slices[LED_MATRIX_ROWS][LED_MATRIX_BITS];
+} frame_t;
+
+// Pins of each port that belong to the matrix
+static uint32_t matrix_masks[PORTS];
+
+// Every row and column off, for the dark slice
+static slice_words_t dark_words;
+
+// Two frames: one being shown, and one that led_matrix_swap() fills in
+static frame_t frames[2];
+static frame_t* volatile shown_frame = &frames[0];
+static frame_t* volatile next_frame = NULL;
+
+// Length of each slice in ticks, set by led_matrix_set_brightness()
+static volatile uint32_t slice_ticks[SLICES];
+
+static uint8_t current_row = 0;
+static uint8_t current_slice = 0;
+
+static volatile led_matrix_isr_stats_t isr_stats;
+
+static void finish_words(slice_words_t* words) {
+  for (uint8_t port = 0; port < PORTS; port++) {
+    words->clear[port] = matrix_masks[port] & ~words->set[port];
+  }
+}
+
+// Convert the back buffer to port words
+static void build_frame(frame_t* frame) {
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    for (uint8_t bit = 0; bit < LED_MATRIX_BITS; bit++) {
+      slice_words_t* words = &frame->slices[row][bit];
+      words->set[0] = 0;
+      words->set[1] = 0;
+
+      // the row is driven high, every other row stays low
+      words->set[row_pins[row] >> 5] |= pin_bit(row_pins[row]);
+
+      // columns are driven low to light a pixel
+      uint8_t weight = 1 << (8 - LED_MATRIX_BITS + bit);
+      for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+        if ((back_buffer[row][col] & weight) == 0) {
+          words->set[col_pins[col] >> 5] |= pin_bit(col_pins[col]);
+        }
+      }
+
+      finish_words(words);
+    }
+  }
+}
+
+void TIMER3_IRQHandler(void) {
+  uint32_t start = DWT->CYCCNT;
+  ROW_TIMER->EVENTS_COMPARE[0] = 0;
+
+  // the timer cleared itself at the end of the last slice, so the length of
+  //  this one is measured from then, not from when the handler runs
+  // Full brightness can be set after the last handler chose the dark slice.
+  //  A zero compare would only match once the counter wraps, so it is shown
+  //  for the shortest slice instead
+  uint32_t ticks = slice_ticks[current_slice];
+  ROW_TIMER->CC[0] = (ticks != 0) ? ticks : LED_MATRIX_MIN_SLICE_TICKS;
+
+  // If the handler started late, the counter may already be past the new
+  //  compare value, which would then only match after the counter wraps. The
+  //  slice is restarted from now instead, and ends up as long as the late
+  //  handler made it
+  ROW_TIMER->TASKS_CAPTURE[1] = 1;
+  if (ROW_TIMER->CC[1] >= ROW_TIMER->CC[0]) {
+    ROW_TIMER->TASKS_CLEAR = 1;
+    ROW_TIMER->EVENTS_COMPARE[0] = 0;
+    NVIC_ClearPendingIRQ(ROW_TIMER_IRQn);
+    isr_stats.late_slices++;
+  }
+
+  const slice_words_t* words = (current_slice == DARK_SLICE) ?
+      &dark_words : &shown_frame->slices[current_row][current_slice];
+  NRF_P0->OUTCLR = words->clear[0];
+  NRF_P1->OUTSET = words->set[1];
+  NRF_P1->OUTCLR = words->clear[1];
+  NRF_P0->OUTSET = words->set[0];
+
+  // move on, skipping the dark slice at full brightness
+  current_slice++;
+  if (current_slice == DARK_SLICE && slice_ticks[DARK_SLICE] == 0) {
+    current_slice++;
+  }
+  if (current_slice == SLICES) {
+    current_slice = 0;
+    current_row++;
+    if (current_row == LED_MATRIX_ROWS) {
+      current_row = 0;
+      isr_stats.frames++;
+
+      // take a new frame only at the start of a frame so it is never torn
+      if (next_frame != NULL) {
+        shown_frame = next_frame;
+        next_frame = NULL;
+      }
+    }
+  }
+
+  uint32_t cycles = DWT->CYCCNT - start;
+  isr_stats.interrupts++;
+  isr_stats.total_cycles += cycles;
+  if (cycles > isr_stats.max_cycles) {
+    isr_stats.max_cycles = cycles;
+  }
+}
+
+static void driver_init(void) {
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    matrix_masks[row_pins[row] >> 5] |= pin_bit(row_pins[row]);
+  }
+
+  // columns high and rows low turns everything off
+  for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+    matrix_masks[col_pins[col] >> 5] |= pin_bit(col_pins[col]);
+    dark_words.set[col_pins[col] >> 5] |= pin_bit(col_pins[col]);
+  }
+  finish_words(&dark_words);
+
+  build_frame(&frames[0]);
+  shown_frame = &frames[0];
+  next_frame = NULL;
+  current_row = 0;
+  current_slice = 0;
+  led_matrix_set_brightness(255);
+
+  // initialize timer: 16 MHz, clear and interrupt at the end of each slice
+  ROW_TIMER->TASKS_STOP = 1;
+  ROW_TIMER->MODE = TIMER_MODE_MODE_Timer;
+  ROW_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  ROW_TIMER->PRESCALER = 0;
+  ROW_TIMER->CC[0] = slice_ticks[0];
+  ROW_TIMER->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+  ROW_TIMER->TASKS_CLEAR = 1;
+  ROW_TIMER->EVENTS_COMPARE[0] = 0;
+  ROW_TIMER->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+  NVIC_ClearPendingIRQ(ROW_TIMER_IRQn);
+  NVIC_EnableIRQ(ROW_TIMER_IRQn);
+  ROW_TIMER->TASKS_START = 1;
+}
+
+void led_matrix_set_brightness(uint8_t brightness) {
+  // At full brightness the bit slices fill the row: 2^k / (2^bits - 1) of it
+  //  for bit k. Lower brightness shortens them and the dark slice takes up
+  //  the rest
+  uint32_t lit_ticks = 0;
+  for (uint8_t bit = 0; bit < LED_MATRIX_BITS; bit++) {
+    uint32_t ticks = (uint64_t)ROW_TICKS * (1u << bit) * brightness / (((1u << LED_MATRIX_BITS) - 1) * 255);
+    if (ticks < LED_MATRIX_MIN_SLICE_TICKS) {
+      ticks = LED_MATRIX_MIN_SLICE_TICKS;
+    }
+    slice_ticks[bit] = ticks;
+    lit_ticks += ticks;
+  }
+
+  // a dark slice too short to time is rounding, so give it to the longest
+  //  bit slice instead
+  uint32_t dark_ticks = (lit_ticks < ROW_TICKS) ? ROW_TICKS - lit_ticks : 0;
+  if (dark_ticks < LED_MATRIX_MIN_SLICE_TICKS) {
+    slice_ticks[LED_MATRIX_BITS - 1] += dark_ticks;
+    dark_ticks = 0;
+  }
+  slice_ticks[DARK_SLICE] = dark_ticks;
+}
+
+void led_matrix_swap(void) {
+  // the handler still has to take the previous frame
+  while (next_frame != NULL) {
+    __WFE();
+  }
+
+  // shown_frame only changes when the handler takes next_frame, so the
+  //  other frame is free
+  frame_t* frame = (shown_frame == &frames[0]) ? &frames[1] : &frames[0];
+  build_frame(frame);
+  __DMB();
+  next_frame = frame;
+}
+
+void led_matrix_get_isr_stats(led_matrix_isr_stats_t* stats) {
+  NVIC_DisableIRQ(ROW_TIMER_IRQn);
+  stats->interrupts = isr_stats.interrupts;
+  stats->frames = isr_stats.frames;
+  stats->max_cycles = isr_stats.max_cycles;
+  stats->total_cycles = isr_stats.total_cycles;
+  stats->late_slices = isr_stats.late_slices;
+  stats->elapsed_cycles = DWT->CYCCNT - stats_start_cycles;
+  NVIC_EnableIRQ(ROW_TIMER_IRQn);
+}
+
+void led_matrix_isr_stats_reset(void) {
+  NVIC_DisableIRQ(ROW_TIMER_IRQn);
+  isr_stats.interrupts = 0;
+  isr_stats.frames = 0;
+  isr_stats.max_cycles = 0;
+  isr_stats.total_cycles = 0;
+  isr_stats.late_slices = 0;
+  stats_start_cycles = DWT->CYCCNT;
+  NVIC_EnableIRQ(ROW_TIMER_IRQn);
+}
+
+
+#elif LED_MATRIX_DRIVER == LED_MATRIX_DRIVER_PWM
+
+// -- PWM driver
+
+#define PWM_INSTANCES 3
+#define PWM_CHANNELS 4
+#define MATRIX_PINS (LED_MATRIX_ROWS + LED_MATRIX_COLS)
+
+// 1 MHz PWM clock, and one PWM period per row
+#define PWM_COUNTERTOP LED_MATRIX_ROW_US
+#if PWM_COUNTERTOP < 3 || PWM_COUNTERTOP > 32767
+#error "LED_MATRIX_ROW_US must be from 3 to 32767 for the PWM driver"
+#endif
+
+// Compare value flag: the output starts the period high and falls at the
+//  compare value. A value of 0 is low for the whole period, and
+//  PWM_COUNTERTOP is high for the whole period
+#define PWM_FALLING_EDGE 0x8000
+
+// PPI channels that start all three PWMs on the same clock, and the EGU
+//  task that triggers them
+#define START_PPI_CHANNEL_A 2
+#define START_PPI_CHANNEL_B 3
+#define START_EGU NRF_EGU3
+
+static NRF_PWM_Type* const pwms[PWM_INSTANCES] = {NRF_PWM0, NRF_PWM1, NRF_PWM2};
+
+// Matrix pin n is channel n % 4 of PWM n / 4: rows first, then columns
+static const uint8_t matrix_pins[MATRIX_PINS] = {
+  LED_ROW1, LED_ROW2, LED_ROW3, LED_ROW4, LED_ROW5,
+  LED_COL1, LED_COL2, LED_COL3, LED_COL4, LED_COL5,
+};
+
+// What one PWM plays for a frame: one value per channel per row, in the
+//  order the individual decoder loads them
+typedef struct {
+  uint16_t values[LED_MATRIX_ROWS][PWM_CHANNELS];
+} pwm_sequence_t;
+
+typedef struct {
+  pwm_sequence_t pwm[PWM_INSTANCES];
+} frame_t;
+
+// Two frames: one being played, and one that led_matrix_swap() fills in
+static frame_t frames[2];
+static frame_t* shown_frame = &frames[0];
+
+// The PWMs may still be reading the previous frame until they restart
+static bool swap_pending = false;
+
+// Last swapped image, so brightness changes can rebuild it
+static uint8_t shown_buffer[LED_MATRIX_ROWS][LED_MATRIX_COLS];
+static uint8_t brightness = 255;
+
+// Convert an image to PWM compare values
+static void build_frame(frame_t* frame, uint8_t image[LED_MATRIX_ROWS][LED_MATRIX_COLS]) {
+  memset(frame, 0, sizeof(frame_t));
+
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    for (uint8_t pin = 0; pin < MATRIX_PINS; pin++) {
+      uint16_t high_ticks;
+      if (pin < LED_MATRIX_ROWS) {
+        // a row is high for its whole period
+        high_ticks = (pin == row) ? PWM_COUNTERTOP : 0;
+      } else {
+        // a column is low for the lit part of the period
+        uint32_t intensity = image[row][pin - LED_MATRIX_ROWS] * brightness;
+        uint16_t lit_ticks = (uint32_t)PWM_COUNTERTOP * intensity / (255 * 255);
+        high_ticks = PWM_COUNTERTOP - lit_ticks;
+      }
+      frame->pwm[pin / PWM_CHANNELS].values[row][pin % PWM_CHANNELS] = high_ticks | PWM_FALLING_EDGE;
+    }
+  }
+}
+
+// Point every PWM at a new frame. They pick it up when they next restart
+//  the sequence, at the end of the current frame
+// The PWMs run on the same clock, and each latches its pointer when a
+//  sequence starts. All pointers are written just after one start, so they
+//  are in place a whole frame before the next start, and no frame mixes old
+//  and new rows. Interrupts are masked from seeing the start to the last
+//  pointer, so only a handler longer than a frame can push the writes past
+//  the next start
+static void show_frame(frame_t* frame) {
+  NRF_PWM_Type* last = pwms[PWM_INSTANCES - 1];
+  last->EVENTS_SEQSTARTED[0] = 0;
+  last->EVENTS_SEQSTARTED[1] = 0;
+
+  __disable_irq();
+  while (!last->EVENTS_SEQSTARTED[0] && !last->EVENTS_SEQSTARTED[1]) {
+    __enable_irq();
+    __disable_irq();
+  }
+  last->EVENTS_SEQSTARTED[0] = 0;
+  last->EVENTS_SEQSTARTED[1] = 0;
+  for (uint8_t i = 0; i < PWM_INSTANCES; i++) {
+    pwms[i]->SEQ[0].PTR = (uint32_t)&frame->pwm[i];
+    pwms[i]->SEQ[1].PTR = (uint32_t)&frame->pwm[i];
+  }
+  __enable_irq();
+
+  // the old frame is read until the next start
+  shown_frame = frame;
+  swap_pending = true;
+}
+
+// Wait until no PWM reads the frame that is not shown
+static void wait_for_swap(void) {
+  NRF_PWM_Type* last = pwms[PWM_INSTANCES - 1];
+  while (swap_pending) {
+    if (last->EVENTS_SEQSTARTED[0] || last->EVENTS_SEQSTARTED[1]) {
+      swap_pending = false;
+    }
+  }
+}
+
+static void driver_init(void) {
+  build_frame(&frames[0], shown_buffer);
+  shown_frame = &frames[0];
+  swap_pending = false;
+
+  for (uint8_t i = 0; i < PWM_INSTANCES; i++) {
+    NRF_PWM_Type* pwm = pwms[i];
+    for (uint8_t channel = 0; channel < PWM_CHANNELS; channel++) {
+      uint8_t pin = i * PWM_CHANNELS + channel;
+      pwm->PSEL.OUT[channel] = (pin < MATRIX_PINS) ? matrix_pins[pin] :
+          (PWM_PSEL_OUT_CONNECT_Disconnected << PWM_PSEL_OUT_CONNECT_Pos);
+    }
+
+    pwm->ENABLE = PWM_ENABLE_ENABLE_Enabled;
+    pwm->MODE = PWM_MODE_UPDOWN_Up;
+    pwm->PRESCALER = PWM_PRESCALER_PRESCALER_DIV_16;
+    pwm->COUNTERTOP = PWM_COUNTERTOP;
+    pwm->DECODER = (PWM_DECODER_LOAD_Individual << PWM_DECODER_LOAD_Pos) |
+                   (PWM_DECODER_MODE_RefreshCount << PWM_DECODER_MODE_Pos);
+
+    // both sequences play the same frame, and the loop restarts forever
+    for (uint8_t seq = 0; seq < 2; seq++) {
+      pwm->SEQ[seq].PTR = (uint32_t)&frames[0].pwm[i];
+      pwm->SEQ[seq].CNT = LED_MATRIX_ROWS * PWM_CHANNELS;
+      pwm->SEQ[seq].REFRESH = 0;
+      pwm->SEQ[seq].ENDDELAY = 0;
+    }
+    pwm->LOOP = 1;
+    pwm->SHORTS = PWM_SHORTS_LOOPSDONE_SEQSTART0_Msk;
+  }
+
+  // start all three on the same event so rows and columns switch together
+  NRF_PPI->CH[START_PPI_CHANNEL_A].EEP = (uint32_t)&START_EGU->EVENTS_TRIGGERED[0];
+  NRF_PPI->CH[START_PPI_CHANNEL_A].TEP = (uint32_t)&pwms[0]->TASKS_SEQSTART[0];
+  NRF_PPI->FORK[START_PPI_CHANNEL_A].TEP = (uint32_t)&pwms[1]->TASKS_SEQSTART[0];
+  NRF_PPI->CH[START_PPI_CHANNEL_B].EEP = (uint32_t)&START_EGU->EVENTS_TRIGGERED[0];
+  NRF_PPI->CH[START_PPI_CHANNEL_B].TEP = (uint32_t)&pwms[2]->TASKS_SEQSTART[0];
+  NRF_PPI->CHENSET = (1u << START_PPI_CHANNEL_A) | (1u << START_PPI_CHANNEL_B);
+  START_EGU->TASKS_TRIGGER[0] = 1;
+
+  // the PPI channels are only needed once
+  NRF_PPI->CHENCLR = (1u << START_PPI_CHANNEL_A) | (1u << START_PPI_CHANNEL_B);
+}
+
+void led_matrix_set_brightness(uint8_t new_brightness) {
+  brightness = new_brightness;
+  wait_for_swap();
+  frame_t* frame = (shown_frame == &frames[0]) ? &frames[1] : &frames[0];
+  build_frame(frame, shown_buffer);
+  show_frame(frame);
+}
+
+void led_matrix_swap(void) {
+  wait_for_swap();
+  memcpy(shown_buffer, back_buffer, sizeof(shown_buffer));
+  frame_t* frame = (shown_frame == &frames[0]) ? &frames[1] : &frames[0];
+  build_frame(frame, shown_buffer);
+  show_frame(frame);
+}
+
+void led_matrix_get_isr_stats(led_matrix_isr_stats_t* stats) {
+  // nothing counts frames, so this is the number the PWM period gives
+  memset(stats, 0, sizeof(led_matrix_isr_stats_t));
+  stats->frames = (uint64_t)(DWT->CYCCNT - stats_start_cycles) / (64 * LED_MATRIX_ROW_US * LED_MATRIX_ROWS);
+  stats->elapsed_cycles = DWT->CYCCNT - stats_start_cycles;
+}
+
+void led_matrix_isr_stats_reset(void) {
+  stats_start_cycles = DWT->CYCCNT;
+}
+
+#else
+#error "Unknown LED_MATRIX_DRIVER"
+#endif
+
+
+// -- External functions
 
 void led_matrix_init(void) {
   // initialize row pins
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    nrf_gpio_pin_clear(row_pins[row]);
+    nrf_gpio_cfg_output(row_pins[row]);
+  }
 
   // initialize col pins
+  for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+    nrf_gpio_pin_set(col_pins[col]);
+    nrf_gpio_cfg_output(col_pins[col]);
+  }
 
-  // set default values for pins
+  // set default state for the LED display
+  led_matrix_clear();
 
-  // initialize timer(s) (Part 3 and onwards)
+  // cycle counter for the handler time
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  led_matrix_isr_stats_reset();
 
-  // set default state for the LED display (Part 4 and onwards)
+  // start refreshing
+  driver_init();
 }
 
+void led_matrix_clear(void) {
+  memset(back_buffer, 0, sizeof(back_buffer));
+}
+
+void led_matrix_set_pixel(uint8_t row, uint8_t col, bool on) {
+  led_matrix_set_intensity(row, col, on ? 255 : 0);
+}
+
+void led_matrix_set_intensity(uint8_t row, uint8_t col, uint8_t intensity) {
+  if (row < LED_MATRIX_ROWS && col < LED_MATRIX_COLS) {
+    back_buffer[row][col] = intensity;
+  }
+}
+
+void led_matrix_set_row(uint8_t row, uint8_t bits) {
+  for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+    led_matrix_set_pixel(row, col, (bits >> col) & 1);
+  }
+}
+
+void led_matrix_draw_char(char c) {
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    led_matrix_set_row(row, font[c & 0x7F][row]);
+  }
+}
 
+void led_matrix_scroll_left(uint8_t column) {
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    memmove(&back_buffer[row][0], &back_buffer[row][1], LED_MATRIX_COLS - 1);
+    back_buffer[row][LED_MATRIX_COLS - 1] = ((column >> row) & 1) ? 255 : 0;
+  }
+}
+
+void led_matrix_isr_stats_print(void) {
+  led_matrix_isr_stats_t stats;
+  led_matrix_get_isr_stats(&stats);
+  uint32_t average = stats.interrupts ? (uint32_t)(stats.total_cycles / stats.interrupts) : 0;
+  uint32_t elapsed_ms = stats.elapsed_cycles / 64000;
+  uint32_t refresh_hz = elapsed_ms ? stats.frames * 1000 / elapsed_ms : 0;
+  uint32_t load_hundredths = stats.elapsed_cycles ? (uint32_t)(stats.total_cycles * 10000 / stats.elapsed_cycles) : 0;
+#if LED_MATRIX_DRIVER == LED_MATRIX_DRIVER_PWM
+  printf("PWM: %lu Hz nominal refresh, set by LED_MATRIX_ROW_US, no interrupts\n", refresh_hz);
+#else
+  printf("%u-bit: %lu Hz refresh, %lu interrupts per frame, %lu slices restarted late\n",
+      LED_MATRIX_BITS, refresh_hz, stats.frames ? stats.interrupts / stats.frames : 0,
+      stats.late_slices);
+#endif
+  printf("  handler average %lu cycles, max %lu cycles, CPU load %lu.%02lu%%\n",
+      average, stats.max_cycles, load_hundredths / 100, load_hundredths % 100);
+}
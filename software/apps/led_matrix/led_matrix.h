@@ -4,8 +4,102 @@
 #include <stdio.h>
 #include <string.h>
 
-// Initialize the LED matrix display
+#define LED_MATRIX_ROWS 5
+#define LED_MATRIX_COLS 5
+
+// How the display is refreshed
+//  TIMER: a TIMER3 interrupt writes the GPIO ports for each row
+//  PWM: PWM0-2 play the rows from RAM with EasyDMA, with no interrupts at all
+#define LED_MATRIX_DRIVER_TIMER 0
+#define LED_MATRIX_DRIVER_PWM 1
+#ifndef LED_MATRIX_DRIVER
+#define LED_MATRIX_DRIVER LED_MATRIX_DRIVER_TIMER
+#endif
+
+// Time each row is lit. Five rows at 1000 us refresh the display at 200 Hz
+#ifndef LED_MATRIX_ROW_US
+#define LED_MATRIX_ROW_US 1000
+#endif
+
+// Brightness bits per pixel with the TIMER driver: 1 for on/off, or 4 or 8
+//  for grayscale. The PWM driver always shows the full intensity
+// Each row is shown once per bit, for a time proportional to the bit's
+//  weight, so a frame takes 5 * LED_MATRIX_BITS interrupts, plus 5 for the
+//  dark slices below full brightness
+#ifndef LED_MATRIX_BITS
+#define LED_MATRIX_BITS 4
+#endif
+
+// Shortest time slice, in 16 MHz ticks. A handler that starts later than this
+//  after its slice began finds the compare already passed, and restarts the
+//  slice, which then runs long. Keep it above the worst interrupt latency, or
+//  dim pixels come out brighter than they should
+#ifndef LED_MATRIX_MIN_SLICE_TICKS
+#define LED_MATRIX_MIN_SLICE_TICKS 32
+#endif
+
+// Time spent in the row scanning interrupt handler. The PWM driver has no
+//  handler: frames is only the nominal count for the elapsed cycles at the
+//  configured row time, and the handler fields are zero
+typedef struct {
+  uint32_t interrupts;
+  uint32_t frames;
+  uint32_t max_cycles;
+  uint64_t total_cycles;
+  // slices restarted because the handler ran after their compare value
+  uint32_t late_slices;
+  // CPU cycles since the stats were reset, for the CPU load. Only valid for
+  //  67 seconds, when the cycle counter wraps
+  uint32_t elapsed_cycles;
+} led_matrix_isr_stats_t;
+
+// Initialize the LED matrix display and start refreshing it
 void led_matrix_init(void);
 
-// You may need to add more functions here
+// Drawing functions change the back buffer, which is not shown until
+//  led_matrix_swap(). Rows and columns count from 0 at the top left
+
+// Turn every pixel of the back buffer off
+void led_matrix_clear(void);
+
+// Set one pixel of the back buffer fully on or off
+void led_matrix_set_pixel(uint8_t row, uint8_t col, bool on);
+
+// Set the intensity of one pixel of the back buffer, 0 to 255. Only the top
+//  LED_MATRIX_BITS bits are shown
+void led_matrix_set_intensity(uint8_t row, uint8_t col, uint8_t intensity);
+
+// Set a row of the back buffer fully on or off. Bit 0 is the leftmost
+//  column, the same as the font
+void led_matrix_set_row(uint8_t row, uint8_t bits);
+
+// Scale the whole display, 0 to 255. Takes effect immediately, without a swap
+// TIMER driver: each lit slice is shortened and the rest of the row is left
+//  dark, so the refresh rate does not change. Slices never get shorter than
+//  LED_MATRIX_MIN_SLICE_TICKS, so dim pixels at low brightness are not exact
+//  and 0 is the dimmest setting rather than off
+// PWM driver: the column duty cycles are scaled, and the last shown frame is
+//  rebuilt, which can wait for a frame like led_matrix_swap()
+void led_matrix_set_brightness(uint8_t brightness);
+
+// Draw a character from the font into the back buffer
+void led_matrix_draw_char(char c);
+
+// Move the back buffer one column to the left and fill the rightmost column
+//  fully on or off. Bit 0 of <column> is the top row, the same as
+//  font_columns
+void led_matrix_scroll_left(uint8_t column);
+
+// Show the back buffer, starting with the next frame
+// The back buffer keeps its contents. If the previous swap has not been shown
+//  yet, this waits for the next frame, at most 5 rows
+void led_matrix_swap(void);
+
+// Get the time spent in the row scanning interrupt handler
+void led_matrix_get_isr_stats(led_matrix_isr_stats_t* stats);
+
+// Restart the interrupt handler statistics
+void led_matrix_isr_stats_reset(void);
 
+// Print the interrupt handler time, refresh rate and CPU load
+void led_matrix_isr_stats_print(void);
@@ -6,11 +6,31 @@
 #include <stdint.h>
 #include <stdio.h>
 
-#include "nrf_delay.h"
+#include "app_timer.h"
+#include "nrf.h"
 
 #include "led_matrix.h"
+#include "marquee.h"
 #include "microbit_v2.h"
 
+#define STEP_MS 100
+
+APP_TIMER_DEF(step_timer);
+static volatile bool next_step = false;
+
+static void step_timer_callback(void* _unused) {
+  next_step = true;
+}
+
+// Fill the back buffer with a diagonal grayscale gradient
+static void draw_gradient(void) {
+  for (uint8_t row = 0; row < LED_MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < LED_MATRIX_COLS; col++) {
+      led_matrix_set_intensity(row, col, (row + col) * 255 / 8);
+    }
+  }
+}
+
 int main(void) {
   printf("Board started!\n");
   
@@ -18,10 +38,25 @@ int main(void) {
   led_matrix_init();
 
   // call other functions here
+  app_timer_init();
+  app_timer_create(&step_timer, APP_TIMER_MODE_REPEATED, step_timer_callback);
+  app_timer_start(step_timer, APP_TIMER_TICKS(STEP_MS), NULL);
 
-  // loop forever
+  // scroll the message one column per step, sleeping in between. The display
+  //  keeps refreshing by itself. Each time the message repeats, a grayscale
+  //  gradient scrolls out ahead of it
+  marquee_start("Hello, world!");
   while (1) {
-    nrf_delay_ms(1000);
+    if (next_step) {
+      next_step = false;
+      if (marquee_step()) {
+        draw_gradient();
+        led_matrix_swap();
+
+        led_matrix_isr_stats_print();
+        led_matrix_isr_stats_reset();
+      }
+    }
+    __WFE();
   }
 }
-
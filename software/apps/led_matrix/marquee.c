@@ -0,0 +1,60 @@
+// Marquee
+//
+// Keeps a position in the text: the current character and the column within
+//  it. Columns past the end of a glyph are the gap between characters.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "font.h"
+#include "led_matrix.h"
+#include "marquee.h"
+
+#define GLYPH_COLS 5
+
+static const char* marquee_text = NULL;
+static uint32_t char_index = 0;
+static uint8_t column_index = 0;
+
+// Next column to scroll in, advancing the position
+static uint8_t next_column(bool* restarted) {
+  char c = marquee_text[char_index];
+  uint8_t column = 0;
+
+  if (c == '\0') {
+    // gap after the text
+    if (++column_index >= MARQUEE_END_GAP) {
+      char_index = 0;
+      column_index = 0;
+      *restarted = true;
+    }
+    return 0;
+  }
+
+  if (column_index < GLYPH_COLS) {
+    column = font_columns[c & 0x7F][column_index];
+  }
+  if (++column_index >= GLYPH_COLS + MARQUEE_CHAR_GAP) {
+    char_index++;
+    column_index = 0;
+  }
+  return column;
+}
+
+void marquee_start(const char* text) {
+  marquee_text = text;
+  char_index = 0;
+  column_index = 0;
+  led_matrix_clear();
+}
+
+bool marquee_step(void) {
+  if (marquee_text == NULL) {
+    return false;
+  }
+
+  bool restarted = false;
+  led_matrix_scroll_left(next_column(&restarted));
+  led_matrix_swap();
+  return restarted;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Scrolls text across the LED matrix one column per step. Each step shifts
+//  the display and draws only the one new column from the font
+
+// Blank columns between characters
+#define MARQUEE_CHAR_GAP 1
+
+// Blank columns after the text, before it starts again
+#define MARQUEE_END_GAP 5
+
+// Start scrolling <text> in from the right. The text is not copied, so it
+//  must stay valid while it scrolls
+void marquee_start(const char* text);
+
+// Scroll one column and show the result with led_matrix_swap()
+// Returns true when the text has just scrolled completely off and restarted
+bool marquee_step(void);
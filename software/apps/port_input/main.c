@@ -0,0 +1,50 @@
+// Port input app
+//
+// Watches buttons and edge connector pins with GPIO SENSE and prints
+//  debounced press, release and long press events
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_error.h"
+#include "nrf.h"
+#include "nrf_pwr_mgmt.h"
+
+#include "microbit_v2.h"
+#include "port_input.h"
+
+static const char* event_names[] = {"press", "release", "long press"};
+
+static void input_event(port_input_event_t event) {
+  printf("P%u.%02u %s\n", event.pin >> 5, event.pin & 0x1F, event_names[event.type]);
+}
+
+int main(void) {
+  printf("Board started!\n");
+
+  ret_code_t error_code = nrf_pwr_mgmt_init();
+  APP_ERROR_CHECK(error_code);
+  port_input_init(input_event);
+
+  // Buttons and touch ring pins have external pull-ups on the board
+  port_input_add(BTN_A, true, false);
+  port_input_add(BTN_B, true, false);
+  port_input_add(TOUCH_RING0, true, false);
+  port_input_add(TOUCH_RING1, true, false);
+  port_input_add(TOUCH_RING2, true, false);
+
+  // Other edge connector pins read high until shorted to ground
+  port_input_add(EDGE_P8, true, true);
+  port_input_add(EDGE_P9, true, true);
+  port_input_add(EDGE_P13, true, true);
+  port_input_add(EDGE_P14, true, true);
+  port_input_add(EDGE_P15, true, true);
+  port_input_add(EDGE_P16, true, true);
+
+  // loop forever, sleeping until the next event
+  while (1) {
+    port_input_process();
+    nrf_pwr_mgmt_run();
+  }
+}
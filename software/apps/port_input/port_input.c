@@ -0,0 +1,244 @@
+// Port input driver
+//
+// Watches any number of pins with the GPIO SENSE mechanism instead of one
+//  GPIOTE IN channel per pin. Each idle pin senses the level it would have
+//  once it changes, which sets its bit in the port LATCH register and fires
+//  the GPIOTE PORT event. Sensing needs no high frequency clock, so idle
+//  current stays low no matter how many pins are watched.
+//
+// The PORT handler turns sensing off for the pins that changed and hands them
+//  to the debounce timer, an RTC2 compare. The RTC2 handler samples them until
+//  they settle, queues press, release and long press events, and turns sensing
+//  back on. RTC2 counts from the low frequency clock, and its compare interrupt
+//  is only enabled while some pin is unsettled or held.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+#include "nrf_gpio.h"
+
+#include "microbit_rtc.h"
+#include "port_input.h"
+
+#define PORTS 2
+#define DEBOUNCE_SAMPLES (PORT_INPUT_DEBOUNCE_MS / PORT_INPUT_SAMPLE_MS)
+#define LONG_PRESS_SAMPLES (PORT_INPUT_LONG_PRESS_MS / PORT_INPUT_SAMPLE_MS)
+
+// RTC2 runs at 32.768 kHz, so a sample period is this many ticks
+#define SAMPLE_TICKS ((PORT_INPUT_SAMPLE_MS * 32768 + 999) / 1000)
+
+typedef struct {
+  bool active_low;
+  // debounced state
+  bool pressed;
+  bool long_press_sent;
+  // samples the level has differed from the debounced state
+  uint8_t change_samples;
+  // samples since the press
+  uint16_t held_samples;
+} pin_state_t;
+
+static NRF_GPIO_Type* const ports[PORTS] = {NRF_P0, NRF_P1};
+
+static pin_state_t pins[PORT_INPUT_MAX_PINS];
+static uint32_t monitored[PORTS];
+
+// Pins the debounce timer is sampling, with sensing off. Only changed by the
+//  timer, and by the PORT handler adding pins to <pending>
+static uint32_t sampling[PORTS];
+static volatile uint32_t pending[PORTS];
+static volatile bool timer_running = false;
+
+// Event queue, filled by the timer and drained by port_input_process()
+static port_input_event_t queue[PORT_INPUT_QUEUE_SIZE];
+static volatile uint32_t queue_head = 0;
+static volatile uint32_t queue_tail = 0;
+static volatile uint32_t dropped_events = 0;
+
+static port_input_callback_t event_callback = NULL;
+
+
+// -- Helpers
+
+static void queue_event(uint8_t pin, port_input_event_type_t type) {
+  uint32_t head = queue_head;
+  if (head - queue_tail == PORT_INPUT_QUEUE_SIZE) {
+    dropped_events++;
+    return;
+  }
+  queue[head % PORT_INPUT_QUEUE_SIZE].pin = pin;
+  queue[head % PORT_INPUT_QUEUE_SIZE].type = type;
+  queue_head = head + 1;
+}
+
+// Sense the level the pin has when it leaves its debounced state
+static void sense_change(uint8_t pin) {
+  bool level_high = pins[pin].pressed != pins[pin].active_low;
+  nrf_gpio_cfg_sense_set(pin, level_high ? NRF_GPIO_PIN_SENSE_LOW : NRF_GPIO_PIN_SENSE_HIGH);
+}
+
+static bool read_pressed(uint8_t pin) {
+  return nrf_gpio_pin_read(pin) != pins[pin].active_low;
+}
+
+// Returns true if the pin still needs sampling
+static bool sample_pin(uint8_t pin) {
+  pin_state_t* state = &pins[pin];
+
+  if (read_pressed(pin) != state->pressed) {
+    state->change_samples++;
+    if (state->change_samples >= DEBOUNCE_SAMPLES) {
+      state->pressed = !state->pressed;
+      state->change_samples = 0;
+      state->held_samples = 0;
+      state->long_press_sent = false;
+      queue_event(pin, state->pressed ? PORT_INPUT_PRESS : PORT_INPUT_RELEASE);
+    }
+  } else {
+    state->change_samples = 0;
+  }
+
+  if (state->pressed && !state->long_press_sent) {
+    state->held_samples++;
+    if (state->held_samples >= LONG_PRESS_SAMPLES) {
+      state->long_press_sent = true;
+      queue_event(pin, PORT_INPUT_LONG_PRESS);
+    }
+  }
+
+  // a pin can go back to sensing once it is settled, and if pressed, once
+  //  its long press is reported
+  return state->change_samples != 0 || (state->pressed && !state->long_press_sent);
+}
+
+// Take the next sample SAMPLE_TICKS from now
+static void debounce_timer_schedule(void) {
+  NRF_RTC2->CC[0] = (NRF_RTC2->COUNTER + SAMPLE_TICKS) & 0xFFFFFF;
+}
+
+void RTC2_IRQHandler(void) {
+  NRF_RTC2->EVENTS_COMPARE[0] = 0;
+  debounce_timer_schedule();
+
+  // pick up pins the PORT handler found
+  __disable_irq();
+  for (uint8_t port = 0; port < PORTS; port++) {
+    sampling[port] |= pending[port];
+    pending[port] = 0;
+  }
+  __enable_irq();
+
+  bool busy = false;
+  for (uint8_t port = 0; port < PORTS; port++) {
+    uint32_t mask = sampling[port];
+    while (mask != 0) {
+      uint8_t bit = __builtin_ctz(mask);
+      mask &= mask - 1;
+
+      uint8_t pin = (port << 5) | bit;
+      if (!sample_pin(pin)) {
+        sampling[port] &= ~(1u << bit);
+        sense_change(pin);
+      }
+    }
+    busy |= sampling[port] != 0;
+  }
+
+  // stop unless the PORT handler added pins meanwhile
+  __disable_irq();
+  if (!busy && pending[0] == 0 && pending[1] == 0) {
+    timer_running = false;
+    NRF_RTC2->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+  }
+  __enable_irq();
+}
+
+void GPIOTE_IRQHandler(void) {
+  NRF_GPIOTE->EVENTS_PORT = 0;
+
+  for (uint8_t port = 0; port < PORTS; port++) {
+    uint32_t latched = ports[port]->LATCH & monitored[port];
+    if (latched == 0) {
+      continue;
+    }
+
+    // stop sensing until the debounce timer is done with these pins
+    uint32_t mask = latched;
+    while (mask != 0) {
+      uint8_t bit = __builtin_ctz(mask);
+      mask &= mask - 1;
+      nrf_gpio_cfg_sense_set((port << 5) | bit, NRF_GPIO_PIN_NOSENSE);
+    }
+    pending[port] |= latched;
+
+    // clearing after sensing is off keeps bouncing from latching again. A
+    //  bit that is still set afterwards fires the PORT event again
+    ports[port]->LATCH = latched;
+  }
+
+  if (!timer_running) {
+    timer_running = true;
+    debounce_timer_schedule();
+    NRF_RTC2->EVENTS_COMPARE[0] = 0;
+    NRF_RTC2->INTENSET = RTC_INTENSET_COMPARE0_Msk;
+  }
+}
+
+
+// -- External functions
+
+void port_input_init(port_input_callback_t callback) {
+  event_callback = callback;
+
+  // RTC2 counts all the time, and the compare interrupt is only enabled
+  //  while pins are being sampled
+  rtc_setup(NRF_RTC2);
+  NRF_RTC2->EVENTS_COMPARE[0] = 0;
+  NRF_RTC2->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+  NVIC_ClearPendingIRQ(RTC2_IRQn);
+  NVIC_EnableIRQ(RTC2_IRQn);
+  NRF_RTC2->TASKS_START = 1;
+
+  // Latched detection: the PORT event fires when any LATCH bit is set, so no
+  //  change is lost while the handler runs
+  for (uint8_t port = 0; port < PORTS; port++) {
+    ports[port]->DETECTMODE = GPIO_DETECTMODE_DETECTMODE_LDETECT;
+  }
+
+  NRF_GPIOTE->EVENTS_PORT = 0;
+  NRF_GPIOTE->INTENSET = GPIOTE_INTENSET_PORT_Msk;
+  NVIC_ClearPendingIRQ(GPIOTE_IRQn);
+  NVIC_EnableIRQ(GPIOTE_IRQn);
+}
+
+void port_input_add(uint8_t pin, bool active_low, bool pullup) {
+  if (pin >= PORT_INPUT_MAX_PINS) {
+    return;
+  }
+
+  pins[pin].active_low = active_low;
+  pins[pin].change_samples = 0;
+  pins[pin].held_samples = 0;
+  pins[pin].long_press_sent = false;
+
+  nrf_gpio_cfg_input(pin, pullup ? NRF_GPIO_PIN_PULLUP : NRF_GPIO_PIN_NOPULL);
+  pins[pin].pressed = read_pressed(pin);
+  ports[pin >> 5]->LATCH = 1u << (pin & 0x1F);
+  monitored[pin >> 5] |= 1u << (pin & 0x1F);
+  sense_change(pin);
+}
+
+void port_input_process(void) {
+  while (queue_tail != queue_head) {
+    port_input_event_t event = queue[queue_tail % PORT_INPUT_QUEUE_SIZE];
+    queue_tail++;
+    if (event_callback != NULL) {
+      event_callback(event);
+    }
+  }
+}
+
+uint32_t port_input_dropped_events(void) {
+  return dropped_events;
+}
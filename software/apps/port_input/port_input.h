@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+
+// Pins that can be monitored: P0.00-P0.31 and P1.00-P1.09, the pins the
+//  nRF52833 has. port_input_add() ignores anything higher
+#define PORT_INPUT_MAX_PINS (32 + 10)
+
+// Debounce sampling period, and how long a level must be stable to count
+#ifndef PORT_INPUT_SAMPLE_MS
+#define PORT_INPUT_SAMPLE_MS 5
+#endif
+#ifndef PORT_INPUT_DEBOUNCE_MS
+#define PORT_INPUT_DEBOUNCE_MS 20
+#endif
+
+// How long a pin must be held for a long press
+#ifndef PORT_INPUT_LONG_PRESS_MS
+#define PORT_INPUT_LONG_PRESS_MS 1000
+#endif
+
+// Number of events that can wait for port_input_process()
+#ifndef PORT_INPUT_QUEUE_SIZE
+#define PORT_INPUT_QUEUE_SIZE 16
+#endif
+
+typedef enum {
+  PORT_INPUT_PRESS = 0,
+  PORT_INPUT_RELEASE,
+  PORT_INPUT_LONG_PRESS,
+} port_input_event_type_t;
+
+typedef struct {
+  uint8_t pin;
+  port_input_event_type_t type;
+} port_input_event_t;
+
+typedef void (*port_input_callback_t)(port_input_event_t event);
+
+// Set up the GPIOTE PORT event and the debounce timer
+// Uses the GPIOTE interrupt and RTC2, and starts the low frequency clock if
+//  it is not running
+// <callback> is called from port_input_process() for each event
+void port_input_init(port_input_callback_t callback);
+
+// Start monitoring <pin>
+// Inputs:
+//  pin - gpio number 0-31 OR (32 + gpio number)
+//  active_low - true if the pin reads low while pressed
+//  pullup - enable the internal pull-up (false leaves the pin floating for
+//   pins with an external pull resistor, like BTN_A and BTN_B)
+void port_input_add(uint8_t pin, bool active_low, bool pullup);
+
+// Call the callback for each queued event. Call from the main loop
+void port_input_process(void);
+
+// Returns the number of events lost because the queue was full
+uint32_t port_input_dropped_events(void);
@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "nrf.h"
 #include "nrf_delay.h"
 
 #include "microbit_v2.h"
@@ -16,17 +17,65 @@ void temp_callback(float temp, void* _unused) {
   printf("Temperature: %f degrees C\n", temp);
 }
 
+void named_temp_callback(float temp, void* name) {
+  printf("%s got %f degrees C\n", (const char*)name, temp);
+}
+
+void stream_callback(float temp, temperature_stream_event_t event, void* _unused) {
+  switch (event) {
+    case TEMPERATURE_STREAM_SAMPLE:
+      printf("Filtered temp: %f degrees C\n", temp);
+      break;
+    case TEMPERATURE_STREAM_ABOVE:
+      printf("Warmed up to %f degrees C\n", temp);
+      break;
+    case TEMPERATURE_STREAM_BELOW:
+      printf("Cooled down to %f degrees C\n", temp);
+      break;
+  }
+}
+
 int main(void) {
   printf("Board started!\n");
 
+  // count CPU cycles for timing reads
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
   // Get temperature without blocking
   get_temperature_nonblocking(temp_callback, NULL);
 
+  // Requests made before it finishes share the same conversion
+  get_temperature_nonblocking(named_temp_callback, "First");
+  get_temperature_nonblocking(named_temp_callback, "Second");
+
+  // Keep a cached value no more than 5 seconds old
+  temperature_cache_init(5000000);
+
+  // Sample 10 times a second in hardware, and print the filtered value every
+  //  5 seconds. Holding a finger on the chip warms it past the threshold
+  float now = get_temperature_blocking();
+  temperature_stream_set_thresholds(now + 0.5, now + 1.0);
+  temperature_stream_start(100000, 50, stream_callback, NULL);
+
   // loop forever
   while (1) {
     nrf_delay_ms(1000);
     printf("Looping\n");
-    printf("New temp: %f degrees C\n", get_temperature_blocking());
+
+    // time the blocking read, to compare sleeping and spinning while waiting
+    uint32_t start = DWT->CYCCNT;
+    float temp = get_temperature_blocking();
+    uint32_t cycles = DWT->CYCCNT - start;
+    printf("New temp: %f degrees C, read in %lu us\n", temp, cycles / 64);
+
+    // never waits for the sensor
+    float cached = 0.0;
+    if (get_temperature_cached(10000000, &cached)) {
+      printf("Cached temp: %f degrees C\n", cached);
+    } else {
+      printf("Cached temp is too old, refreshing\n");
+    }
   }
 }
 
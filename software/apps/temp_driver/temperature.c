@@ -8,36 +8,160 @@
 
 #include "nrf.h"
 
+#include "microbit_rtc.h"
+#include "microbit_sleep.h"
 #include "temperature.h"
 
-static void (*callback_fn)(float, void*) = NULL;
-static void* callback_context = NULL;
+// A caller waiting for the conversion in progress
+typedef struct {
+  void (*callback)(float, void*);
+  void* context;
+} temp_request_t;
+
+static temp_request_t requests[TEMPERATURE_MAX_REQUESTS];
+static volatile uint8_t request_count = 0;
+
+// Last measured value, kept for get_temperature_cached()
+static float cached_temp = 0.0;
+static uint64_t cached_ticks = 0;
+static volatile bool cache_valid = false;
+static volatile bool refresh_pending = false;
+
+// RTC2 counts in 32.768 kHz ticks for the age of the cached value. It is 24
+//  bits wide, so wraps are counted to make a 64-bit time
+static bool cache_clock_started = false;
+static volatile uint32_t rtc_epoch = 0;
+static uint32_t refresh_ticks = 0;
+
+// Streaming: RTC0 starts conversions through PPI, and the DATARDY handler
+//  filters them. Filter values are in 1/256 of the sensor's 0.25 degree steps
+static volatile bool streaming = false;
+static void (*stream_callback)(float, temperature_stream_event_t, void*) = NULL;
+static void* stream_context = NULL;
+static uint16_t stream_report_every = 0;
+static uint16_t stream_samples = 0;
+static bool filter_started = false;
+static int32_t filter_value = 0;
+static bool thresholds_set = false;
+static bool above_threshold = false;
+static int32_t threshold_low = 0;
+static int32_t threshold_high = 0;
+
+static inline int32_t degrees_to_filter(float degrees) {
+  return (int32_t)(degrees * 4 * 256);
+}
+
+static inline float filter_to_degrees(int32_t value) {
+  return ((float)value) / (4 * 256);
+}
+
+// Run one streamed sample through the filter, and tell the application if it
+//  is due a value or the filtered temperature crossed a threshold
+static void stream_sample(int32_t raw) {
+  // exponential moving average in fixed point, started at the first sample
+  int32_t sample = raw * 256;
+  if (!filter_started) {
+    filter_value = sample;
+    filter_started = true;
+  } else {
+    filter_value += (sample - filter_value) >> TEMPERATURE_STREAM_FILTER_SHIFT;
+  }
+
+  // the thresholds are a hysteresis band, so noise around one of them is
+  //  reported only once
+  temperature_stream_event_t event = TEMPERATURE_STREAM_SAMPLE;
+  bool crossed = false;
+  if (thresholds_set) {
+    if (!above_threshold && filter_value >= threshold_high) {
+      above_threshold = true;
+      event = TEMPERATURE_STREAM_ABOVE;
+      crossed = true;
+    } else if (above_threshold && filter_value <= threshold_low) {
+      above_threshold = false;
+      event = TEMPERATURE_STREAM_BELOW;
+      crossed = true;
+    }
+  }
+
+  bool report = false;
+  if (stream_report_every != 0) {
+    stream_samples++;
+    if (stream_samples == stream_report_every) {
+      stream_samples = 0;
+      report = true;
+    }
+  }
+
+  if ((crossed || report) && stream_callback != NULL) {
+    stream_callback(filter_to_degrees(filter_value), event, stream_context);
+  }
+}
 
 // Interrupt handler for Temperature sensor
 void TEMP_IRQHandler(void) {
   NRF_TEMP->EVENTS_DATARDY = 0;
+  int32_t raw = NRF_TEMP->TEMP;
+  float temperature = ((float)raw)/4.0;
+
+  if (streaming) {
+    stream_sample(raw);
+  }
 
-  // Be sure to only call function if non-null
-  if (callback_fn) {
-    float temperature = ((float)NRF_TEMP->TEMP)/4.0;
-    callback_fn(temperature, callback_context);
+  // every conversion refreshes the cache, whoever asked for it
+  if (cache_clock_started) {
+    uint64_t now = rtc_read_ticks(NRF_RTC2, &rtc_epoch);
+    uint32_t primask = critical_enter();
+    cached_temp = temperature;
+    cached_ticks = now;
+    cache_valid = true;
+    critical_exit(primask);
+  }
+
+  // Take every waiting request before calling any of them. A callback that
+  //  asks again starts a new conversion instead of getting this value back
+  temp_request_t served[TEMPERATURE_MAX_REQUESTS];
+  uint32_t primask = critical_enter();
+  uint8_t count = request_count;
+  for (uint8_t i = 0; i < count; i++) {
+    served[i] = requests[i];
+  }
+  request_count = 0;
+  critical_exit(primask);
+
+  for (uint8_t i = 0; i < count; i++) {
+    served[i].callback(temperature, served[i].context);
   }
 }
 
-void get_temperature_nonblocking(void (*callback)(float, void*), void* context) {
-  // Save callback
-  callback_fn = callback;
-  callback_context = context;
+bool get_temperature_nonblocking(void (*callback)(float, void*), void* context) {
+  if (callback == NULL) {
+    return false;
+  }
 
-  // Enable lowest-priority interrupts
-  NRF_TEMP->INTENSET = 1;
-  NVIC_EnableIRQ(TEMP_IRQn);
-  NVIC_SetPriority(TEMP_IRQn, 7);
+  uint32_t primask = critical_enter();
+  if (request_count == TEMPERATURE_MAX_REQUESTS) {
+    critical_exit(primask);
+    return false;
+  }
+  requests[request_count].callback = callback;
+  requests[request_count].context = context;
+  request_count++;
+  bool start = (request_count == 1);
+  critical_exit(primask);
 
-  // Start temperature sensor
-  NRF_TEMP->TASKS_START = 1;
+  // Only the first waiting request starts a conversion. The rest are served
+  //  by the same DATARDY interrupt. While streaming, RTC0 starts the next one
+  if (start && !streaming) {
+    // Enable lowest-priority interrupts
+    NRF_TEMP->INTENSET = 1;
+    NVIC_SetPriority(TEMP_IRQn, 7);
+    NVIC_EnableIRQ(TEMP_IRQn);
 
-  return;
+    // Start temperature sensor
+    NRF_TEMP->TASKS_START = 1;
+  }
+
+  return true;
 }
 
 typedef struct {
@@ -53,9 +177,170 @@ static void temp_handler(float temp, void* context) {
 float get_temperature_blocking(void) {
 
   volatile handler_info_t handler_info = {.temp = 0.0, .flag = false};
-  get_temperature_nonblocking(temp_handler, (void*)&handler_info);
+  // a full queue drains within one conversion, so keep asking
+  while (!get_temperature_nonblocking(temp_handler, (void*)&handler_info));
+#if TEMPERATURE_BLOCKING_SLEEP
+  sleep_until_flag(&handler_info.flag);
+#else
   while (!handler_info.flag);
+#endif
 
   return handler_info.temp;
 }
 
+static void refresh_callback(float temp, void* _unused) {
+  // the value is already in the cache
+  refresh_pending = false;
+}
+
+// Start a conversion to refresh the cache, unless one is on its way
+static void start_refresh(void) {
+  uint32_t primask = critical_enter();
+  bool start = !refresh_pending;
+  refresh_pending = true;
+  critical_exit(primask);
+
+  if (start && !get_temperature_nonblocking(refresh_callback, NULL)) {
+    // the queue is full, so a conversion is running and will fill the cache
+    refresh_pending = false;
+  }
+}
+
+// Counts RTC2 wraps, and refreshes the cache periodically
+void RTC2_IRQHandler(void) {
+  uint32_t primask = critical_enter();
+  if (NRF_RTC2->EVENTS_OVRFLW) {
+    NRF_RTC2->EVENTS_OVRFLW = 0;
+    rtc_epoch++;
+  }
+  critical_exit(primask);
+
+  if (NRF_RTC2->EVENTS_COMPARE[0]) {
+    NRF_RTC2->EVENTS_COMPARE[0] = 0;
+    NRF_RTC2->CC[0] = (NRF_RTC2->CC[0] + refresh_ticks) & 0xFFFFFF;
+    start_refresh();
+  }
+}
+
+void temperature_cache_init(uint32_t refresh_period_us) {
+  rtc_setup(NRF_RTC2);
+  NRF_RTC2->EVENTS_OVRFLW = 0;
+  NRF_RTC2->EVENTS_COMPARE[0] = 0;
+  NRF_RTC2->INTENSET = RTC_INTENSET_OVRFLW_Msk;
+
+  // the compare has to come back around before the 24-bit counter does
+  refresh_ticks = (uint32_t)rtc_us_to_ticks(refresh_period_us);
+  if (refresh_ticks > 0xFFFFFF) {
+    refresh_ticks = 0xFFFFFF;
+  }
+  // and the RTC misses compares less than two ticks ahead
+  if (refresh_ticks == 1) {
+    refresh_ticks = 2;
+  }
+  if (refresh_ticks != 0) {
+    NRF_RTC2->CC[0] = refresh_ticks;
+    NRF_RTC2->INTENSET = RTC_INTENSET_COMPARE0_Msk;
+  } else {
+    NRF_RTC2->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+  }
+
+  NVIC_SetPriority(RTC2_IRQn, 7);
+  NVIC_EnableIRQ(RTC2_IRQn);
+  NRF_RTC2->TASKS_START = 1;
+  cache_clock_started = true;
+
+  // fill the cache right away
+  start_refresh();
+}
+
+bool get_temperature_cached(uint32_t max_age_us, float* temperature) {
+  uint32_t primask = critical_enter();
+  bool valid = cache_valid;
+  float temp = cached_temp;
+  uint64_t ticks = cached_ticks;
+  critical_exit(primask);
+
+  // read after the value, so a conversion finishing in between never looks
+  //  like it came from the future
+  uint64_t now = rtc_read_ticks(NRF_RTC2, &rtc_epoch);
+
+  if (valid) {
+    *temperature = temp;
+    if (now - ticks <= rtc_us_to_ticks(max_age_us)) {
+      return true;
+    }
+  }
+
+  // too old, or never measured: measure again in the background
+  start_refresh();
+  return false;
+}
+
+void temperature_stream_start(uint32_t period_us, uint16_t report_every,
+    void (*callback)(float, temperature_stream_event_t, void*), void* context) {
+  temperature_stream_stop();
+
+  stream_callback = callback;
+  stream_context = context;
+  stream_report_every = report_every;
+  stream_samples = 0;
+  filter_started = false;
+  above_threshold = false;
+
+  // COMPARE[0] clears the counter through PPI, which takes one more tick, so
+  //  a period of n ticks compares at n - 1. A conversion takes about 36 us,
+  //  so periods are at least two ticks
+  uint32_t ticks = (uint32_t)rtc_us_to_ticks(period_us);
+  if (ticks < 2) {
+    ticks = 2;
+  }
+  if (ticks > 0x1000000) {
+    ticks = 0x1000000;
+  }
+  rtc_setup(NRF_RTC0);
+  NRF_RTC0->CC[0] = ticks - 1;
+  NRF_RTC0->EVTENSET = RTC_EVTENSET_COMPARE0_Msk;
+
+  // each compare starts a conversion and restarts the period, with no CPU
+  NRF_PPI->CH[TEMPERATURE_STREAM_PPI_CHANNEL].EEP = (uint32_t)&NRF_RTC0->EVENTS_COMPARE[0];
+  NRF_PPI->CH[TEMPERATURE_STREAM_PPI_CHANNEL].TEP = (uint32_t)&NRF_TEMP->TASKS_START;
+  NRF_PPI->FORK[TEMPERATURE_STREAM_PPI_CHANNEL].TEP = (uint32_t)&NRF_RTC0->TASKS_CLEAR;
+  NRF_PPI->CHENSET = 1u << TEMPERATURE_STREAM_PPI_CHANNEL;
+
+  // Enable lowest-priority interrupts
+  NRF_TEMP->INTENSET = 1;
+  NVIC_SetPriority(TEMP_IRQn, 7);
+  NVIC_EnableIRQ(TEMP_IRQn);
+
+  streaming = true;
+  NRF_RTC0->TASKS_START = 1;
+}
+
+void temperature_stream_set_thresholds(float low, float high) {
+  uint32_t primask = critical_enter();
+  threshold_low = degrees_to_filter(low);
+  threshold_high = degrees_to_filter(high);
+  above_threshold = false;
+  thresholds_set = true;
+  critical_exit(primask);
+}
+
+void temperature_stream_stop(void) {
+  if (!streaming) {
+    return;
+  }
+
+  NRF_PPI->CHENCLR = 1u << TEMPERATURE_STREAM_PPI_CHANNEL;
+  NRF_RTC0->TASKS_STOP = 1;
+  NRF_RTC0->EVTENCLR = RTC_EVTENCLR_COMPARE0_Msk;
+
+  // a streamed conversion may still be running. Its interrupt serves any
+  //  waiting requests, and otherwise the next request starts one
+  uint32_t primask = critical_enter();
+  streaming = false;
+  bool waiting = (request_count != 0);
+  critical_exit(primask);
+  if (waiting) {
+    NRF_TEMP->TASKS_START = 1;
+  }
+}
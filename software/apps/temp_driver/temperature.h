@@ -1,10 +1,85 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
+// Most requests that can wait for one conversion at once
+#ifndef TEMPERATURE_MAX_REQUESTS
+#define TEMPERATURE_MAX_REQUESTS 8
+#endif
+
+// Whether get_temperature_blocking() sleeps in WFE while the conversion runs,
+//  rather than spinning on the flag the interrupt handler sets
+#ifndef TEMPERATURE_BLOCKING_SLEEP
+#define TEMPERATURE_BLOCKING_SLEEP 1
+#endif
+
+// Streaming: shift of the exponential moving average, which moves 1/2^shift
+//  of the way to each new sample. 3 follows a step to within 10% after 18
+//  samples
+#ifndef TEMPERATURE_STREAM_FILTER_SHIFT
+#define TEMPERATURE_STREAM_FILTER_SHIFT 3
+#endif
+
+// Streaming: PPI channel from the RTC0 compare to the TEMP start task
+#ifndef TEMPERATURE_STREAM_PPI_CHANNEL
+#define TEMPERATURE_STREAM_PPI_CHANNEL 0
+#endif
+
+// Why a streaming callback was called
+typedef enum {
+  TEMPERATURE_STREAM_SAMPLE, // the periodic filtered value
+  TEMPERATURE_STREAM_ABOVE,  // the filtered value rose to the high threshold
+  TEMPERATURE_STREAM_BELOW,  // the filtered value fell to the low threshold
+} temperature_stream_event_t;
+
 // Get temperature value
 // Non-blocking function. Calls callback with context when temperature is ready
-void get_temperature_nonblocking(void (*callback)(float, void*), void* context);
+// Requests made while a conversion is running wait for that conversion rather
+//  than starting another, so any number of callers share one measurement.
+//  Callbacks run in the TEMP interrupt handler, in the order requested
+// Returns false, without calling the callback, if TEMPERATURE_MAX_REQUESTS
+//  requests are already waiting
+bool get_temperature_nonblocking(void (*callback)(float, void*), void* context);
 
 // Get temperature value
 // Blocking function. Returns temperature value when ready
+// Must not be called from an interrupt handler at priority 7 or higher
 float get_temperature_blocking(void);
 
+// Start the RTC2 clock that keeps the age of the last measured value, and
+//  measure the temperature for the first time
+// With a non-zero <refresh_period_us> the value is also measured again every
+//  period in the background, so get_temperature_cached() always finds a fresh
+//  one. 0 measures only when get_temperature_cached() finds the value too old.
+//  Periods are limited to the RTC range of about 512 seconds
+void temperature_cache_init(uint32_t refresh_period_us);
+
+// Get the last measured temperature without waiting for the sensor
+// Returns true if it was measured at most <max_age_us> ago. Otherwise a new
+//  measurement is started in the background and false is returned, with
+//  <temperature> set to the old value if there is one. Every conversion
+//  updates the value, including ones from the functions above
+// Requires temperature_cache_init()
+bool get_temperature_cached(uint32_t max_age_us, float* temperature);
+
+// Measure the temperature every <period_us> without the CPU: RTC0 starts each
+//  conversion through PPI, and the CPU can sleep until one finishes
+// The DATARDY interrupt filters each sample with an exponential moving
+//  average, and calls <callback> with the filtered value every
+//  <report_every> samples, or only for threshold crossings if it is 0.
+//  Callbacks run in the TEMP interrupt handler
+// While streaming, requests from the functions above are served by the next
+//  sample rather than starting their own conversion, so they can wait up to a
+//  period. Periods are limited to the RTC range of about 512 seconds
+void temperature_stream_start(uint32_t period_us, uint16_t report_every,
+    void (*callback)(float, temperature_stream_event_t, void*), void* context);
+
+// Report when the filtered temperature rises to <high> or falls back to
+//  <low> degrees C while streaming. Between the two nothing is reported, so
+//  noise around one threshold does not report repeatedly
+void temperature_stream_set_thresholds(float low, float high);
+
+// Stop streaming
+void temperature_stream_stop(void);
+
@@ -6,34 +6,60 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "nrf.h"
 #include "nrf_delay.h"
 
+#include "microbit_sleep.h"
 #include "microbit_v2.h"
 
+// Whether to sleep in WFE until the measurement is ready, rather than polling
+//  DATARDY
+#ifndef TEMP_MMIO_SLEEP
+#define TEMP_MMIO_SLEEP 1
+#endif
+
 int main(void) {
   printf("Board started!\n");
 
+  // count CPU cycles for timing measurements
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  // enable the DATARDY interrupt in the peripheral, so it can wake the CPU
+  *(uint32_t*)(0x4000C304) = 1;
+
   // loop forever
   while (1) {
 
     // start a measurement
+    uint32_t start = DWT->CYCCNT;
     *(uint32_t*)(0x4000C000) = 1;
 
+#if TEMP_MMIO_SLEEP
+    // sleep until ready. DATARDY makes the TEMP interrupt pending, which wakes
+    //  the CPU, but the interrupt stays disabled in the NVIC so no handler runs
+    sleep_until_event((volatile uint32_t*)(0x4000C100), TEMP_IRQn);
+#else
     // wait until ready
     volatile uint32_t ready = *(uint32_t*)(0x4000C100);
     while (!ready) {
       ready = *(uint32_t*)(0x4000C100);
     }
+#endif
 
     /* WARNING: we can't write the code this way!
      *  Without `volatile`, the compiler optimizes out the memory access
     while (!*(uint32_t*)(0x4000C100));
     */
+    uint32_t cycles = DWT->CYCCNT - start;
+
+    // clear the event for the next measurement
+    *(uint32_t*)(0x4000C100) = 0;
 
     // read data and print it
     volatile int32_t value = *(int32_t*)(0x4000C508);
     float temperature = ((float)value)/4.0;
-    printf("Temperature=%f degrees C\n", temperature);
+    printf("Temperature=%f degrees C, ready in %lu us\n", temperature, cycles / 64);
 
     nrf_delay_ms(1000);
   }
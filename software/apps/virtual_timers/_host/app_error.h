@@ -0,0 +1,17 @@
+// Host stand-in for the nRF SDK's "app_error.h"
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NRF_SUCCESS 0
+#define NRF_ERROR_NULL 14
+
+#define APP_ERROR_CHECK(err_code) do {                              \
+    if ((err_code) != NRF_SUCCESS) {                                \
+      fprintf(stderr, "ERROR %d at %s:%d\n", (int)(err_code),       \
+          __FILE__, __LINE__);                                      \
+      abort();                                                      \
+    }                                                               \
+  } while (0)
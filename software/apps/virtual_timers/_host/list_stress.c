@@ -0,0 +1,130 @@
+// Linked list start/cancel stress test
+//
+// Runs millions of random timer starts and cancels against the sorted linked
+//  list, using the node pool and timer IDs the same way the virtual timer
+//  library does. Some cancels reuse the ID of a timer that was already
+//  cancelled, which the pool must reject. The list is checked for consistency along the
+//  way and the time per operation is reported.
+//
+// Built once per list variant (see the Makefile) so the singly and doubly
+//  linked versions can be compared.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "virtual_timer_linked_list.h"
+#include "virtual_timer_pool.h"
+
+#define OPERATIONS 4000000
+#define MAX_DELAY 1000000
+#define CHECK_INTERVAL 65536
+
+// xorshift32, so every variant sees the same sequence of operations
+static uint32_t rng_state = 0x12345678;
+static uint32_t rng(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// walk the list and make sure it is sorted, linked both ways and holds
+//  exactly the running timers
+static void check_list(uint32_t expected_count) {
+  uint32_t count = 0;
+  node_t* prev = NULL;
+  for (node_t* node = list_get_first(); node != NULL; node = node->next) {
+    if (prev != NULL && node->timer_value < prev->timer_value) {
+      printf("ERROR: list is not sorted\n");
+      exit(1);
+    }
+#if VIRTUAL_TIMER_LIST_DOUBLY_LINKED
+    if (node->prev != prev) {
+      printf("ERROR: back link is wrong\n");
+      exit(1);
+    }
+#endif
+    prev = node;
+    count++;
+  }
+
+  if (count != expected_count) {
+    printf("ERROR: list holds %u timers, expected %u\n", count, expected_count);
+    exit(1);
+  }
+}
+
+int main(void) {
+  // IDs of running timers, plus the most recently cancelled one
+  static uint32_t ids[VIRTUAL_TIMER_POOL_SIZE];
+  uint32_t running = 0;
+  uint32_t cancelled_id = 0;
+  uint64_t now = 0;
+
+  uint64_t starts = 0;
+  uint64_t cancels = 0;
+  uint64_t stale_cancels = 0;
+
+  pool_init();
+
+  double start = seconds();
+  for (uint32_t op = 0; op < OPERATIONS; op++) {
+    now += rng() % 16;
+    uint32_t choice = rng();
+
+    if (running == 0 || ((choice & 1) && running < VIRTUAL_TIMER_POOL_SIZE)) {
+      // start a timer
+      node_t* node = pool_alloc();
+      node->prev = NULL;
+      node->timer_value = now + rng() % MAX_DELAY;
+      list_insert_sorted(node);
+
+      ids[running++] = pool_node_id(node);
+      starts++;
+    } else if ((choice & 0xE) == 0 && cancelled_id != 0) {
+      // cancel a timer that was already cancelled
+      if (pool_lookup(cancelled_id) != NULL) {
+        printf("ERROR: stale ID was accepted\n");
+        exit(1);
+      }
+      stale_cancels++;
+    } else {
+      // cancel a running timer
+      uint32_t index = rng() % running;
+      node_t* node = pool_lookup(ids[index]);
+      if (node == NULL) {
+        printf("ERROR: running timer ID was rejected\n");
+        exit(1);
+      }
+      list_remove(node);
+      pool_free(node);
+
+      cancelled_id = ids[index];
+      ids[index] = ids[--running];
+      cancels++;
+    }
+
+    if (op % CHECK_INTERVAL == 0) {
+      check_list(running);
+    }
+  }
+  double elapsed = seconds() - start;
+  check_list(running);
+
+  printf("%s linked list, %u timers max\n",
+      VIRTUAL_TIMER_LIST_DOUBLY_LINKED ? "doubly" : "singly", VIRTUAL_TIMER_POOL_SIZE);
+  printf("  %llu starts, %llu cancels, %llu stale IDs rejected\n",
+      (unsigned long long)starts, (unsigned long long)cancels,
+      (unsigned long long)stale_cancels);
+  printf("  %.1f ns per operation\n", elapsed * 1e9 / OPERATIONS);
+  return 0;
+}
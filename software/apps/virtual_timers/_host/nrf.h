@@ -0,0 +1,147 @@
+// Host stand-in for the nRF SDK's "nrf.h"
+//
+// Enough to compile the timer data structures on a Linux machine. The
+//  peripherals used by virtual_timer.c are simulated by sim_nrf.c, which must
+//  be linked in when they are used
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// -- Peripherals
+
+typedef struct {
+  volatile uint32_t TASKS_START;
+  volatile uint32_t TASKS_STOP;
+  volatile uint32_t TASKS_COUNT;
+  volatile uint32_t TASKS_CLEAR;
+  volatile uint32_t TASKS_CAPTURE[6];
+  volatile uint32_t EVENTS_COMPARE[6];
+  volatile uint32_t SHORTS;
+  volatile uint32_t INTENSET;
+  volatile uint32_t INTENCLR;
+  volatile uint32_t MODE;
+  volatile uint32_t BITMODE;
+  volatile uint32_t PRESCALER;
+  volatile uint32_t CC[6];
+} NRF_TIMER_Type;
+
+typedef struct {
+  volatile uint32_t TASKS_TRIGGER[16];
+  volatile uint32_t EVENTS_TRIGGERED[16];
+  volatile uint32_t INTEN;
+  volatile uint32_t INTENSET;
+  volatile uint32_t INTENCLR;
+} NRF_EGU_Type;
+
+typedef struct {
+  volatile uint32_t TASKS_START;
+  volatile uint32_t TASKS_STOP;
+  volatile uint32_t TASKS_CLEAR;
+  volatile uint32_t TASKS_TRIGOVRFLW;
+  volatile uint32_t EVENTS_TICK;
+  volatile uint32_t EVENTS_OVRFLW;
+  volatile uint32_t EVENTS_COMPARE[4];
+  volatile uint32_t INTENSET;
+  volatile uint32_t INTENCLR;
+  volatile uint32_t EVTEN;
+  volatile uint32_t EVTENSET;
+  volatile uint32_t EVTENCLR;
+  volatile uint32_t COUNTER;
+  volatile uint32_t PRESCALER;
+  volatile uint32_t CC[4];
+} NRF_RTC_Type;
+
+typedef struct {
+  volatile uint32_t TASKS_LFCLKSTART;
+  volatile uint32_t TASKS_LFCLKSTOP;
+  volatile uint32_t EVENTS_LFCLKSTARTED;
+  volatile uint32_t LFCLKSTAT;
+  volatile uint32_t LFCLKSRC;
+} NRF_CLOCK_Type;
+
+// Event and task endpoints hold the low 32 bits of a register address, which
+//  is the whole address on the Microbit
+typedef struct {
+  volatile uint32_t CHEN;
+  volatile uint32_t CHENSET;
+  volatile uint32_t CHENCLR;
+  struct {
+    volatile uint32_t EEP;
+    volatile uint32_t TEP;
+  } CH[20];
+  struct {
+    volatile uint32_t TEP;
+  } FORK[32];
+} NRF_PPI_Type;
+
+typedef struct {
+  volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t CYCCNT;
+} DWT_Type;
+
+// Every access to a simulated peripheral goes through one of these, which
+//  performs tasks written since the last access, moves the simulated clock
+//  and may deliver interrupts
+NRF_TIMER_Type* sim_timer4(void);
+NRF_EGU_Type* sim_egu1(void);
+NRF_RTC_Type* sim_rtc1(void);
+NRF_CLOCK_Type* sim_clock(void);
+NRF_PPI_Type* sim_ppi(void);
+DWT_Type* sim_dwt(void);
+extern CoreDebug_Type sim_core_debug;
+
+#define NRF_TIMER4 (sim_timer4())
+#define NRF_EGU1 (sim_egu1())
+#define NRF_RTC1 (sim_rtc1())
+#define NRF_CLOCK (sim_clock())
+#define NRF_PPI (sim_ppi())
+#define DWT (sim_dwt())
+#define CoreDebug (&sim_core_debug)
+
+#define TIMER_MODE_MODE_Timer 0
+#define TIMER_BITMODE_BITMODE_32Bit 3
+#define TIMER_INTENSET_COMPARE0_Pos 16
+#define RTC_INTENSET_OVRFLW_Msk (1u << 1)
+#define RTC_INTENSET_COMPARE0_Msk (1u << 16)
+#define RTC_INTENCLR_COMPARE0_Msk (1u << 16)
+#define RTC_EVTENSET_COMPARE1_Msk (1u << 17)
+#define RTC_EVTENCLR_COMPARE1_Msk (1u << 17)
+#define CLOCK_LFCLKSRC_SRC_RC 0
+#define CLOCK_LFCLKSRC_SRC_Pos 0
+#define CLOCK_LFCLKSTAT_STATE_Msk (1u << 16)
+#define CoreDebug_DEMCR_TRCENA_Msk (1u << 24)
+#define DWT_CTRL_CYCCNTENA_Msk 1u
+
+
+// -- Interrupts
+
+typedef enum {
+  RTC1_IRQn = 17,
+  SWI1_EGU1_IRQn = 21,
+  TIMER4_IRQn = 27,
+  // stands in for any other peripheral interrupt, see sim_inject_interrupt()
+  SIM_INJECTED_IRQn = 47,
+  SIM_IRQ_COUNT = 48,
+} IRQn_Type;
+
+void TIMER4_IRQHandler(void);
+void SWI1_EGU1_IRQHandler(void);
+void RTC1_IRQHandler(void);
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+void __DMB(void);
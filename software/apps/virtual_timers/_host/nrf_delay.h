@@ -0,0 +1,9 @@
+// Host stand-in for the nRF SDK's "nrf_delay.h"
+
+#pragma once
+
+#include <stdint.h>
+
+static inline void nrf_delay_ms(uint32_t ms) {
+  (void)ms;
+}
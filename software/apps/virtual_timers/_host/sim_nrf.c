@@ -0,0 +1,614 @@
+// Simulated nRF52833 peripherals for host builds
+//
+// Register writes are plain memory writes, so tasks and INTENSET/INTENCLR
+//  writes are acted upon at the next access, before any time passes. The
+//  TIMER4 counter runs at 1 MHz and raises a compare event when it reaches a
+//  CC value, like the hardware: a CC written with a value the counter already
+//  passed does not fire until the counter comes around again.
+//
+// RTC1 counts 32.768 kHz ticks. Tick n lands on the microsecond
+//  n * 15625 / 512 rounded down, the same conversion virtual_timer.c uses, so
+//  the two clocks never drift apart. An RTC CC written with the counter at N
+//  does not fire for N or N + 1, which the hardware does not guarantee either.
+//  PPI channels pass RTC1 events to TIMER4 tasks, at the tick of the event.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "sim_nrf.h"
+
+// execution priority of thread mode, below every interrupt
+#define THREAD_PRIORITY 256
+
+// CPU clock, for the DWT cycle counter
+#define CPU_MHZ 64
+
+// `touched` is set whenever code gets the register pointer, so registers are
+//  only checked for writes when there can be some
+typedef struct {
+  NRF_TIMER_Type regs;
+  uint32_t inten;
+  uint32_t counter;
+  bool running;
+  bool touched;
+} sim_timer_t;
+
+typedef struct {
+  NRF_EGU_Type regs;
+  uint32_t inten;
+  bool touched;
+} sim_egu_t;
+
+// The counter is (tick - origin) while running, and `stopped_counter` while
+//  not. A compare channel only matches from `armed_tick` on
+typedef struct {
+  NRF_RTC_Type regs;
+  uint32_t inten;
+  uint32_t evten;
+  bool running;
+  uint64_t origin;
+  uint32_t stopped_counter;
+  uint32_t cc_seen[4];
+  uint64_t armed_tick[4];
+  bool touched;
+} sim_rtc_t;
+
+typedef struct {
+  NRF_PPI_Type regs;
+  uint32_t chen;
+  bool touched;
+} sim_ppi_t;
+
+static uint64_t time_ns = 0;
+static uint32_t access_cost_ns = 0;
+static uint64_t access_count = 0;
+
+static sim_timer_t timer4;
+static sim_egu_t egu1;
+static sim_rtc_t rtc1;
+static NRF_CLOCK_Type clock_regs;
+static sim_ppi_t ppi;
+static uint32_t timer4_starts = 0;
+static DWT_Type dwt;
+CoreDebug_Type sim_core_debug;
+
+// NVIC state
+static bool irq_enabled[SIM_IRQ_COUNT];
+static uint64_t irq_pending = 0;
+static uint32_t irq_priority[SIM_IRQ_COUNT];
+static uint32_t primask = 0;
+static uint32_t execution_priority = THREAD_PRIORITY;
+
+// injected interrupt
+static void (*injected_handler)(void) = NULL;
+static uint32_t inject_countdown = 0;
+
+// SWI1 is only defined when the library defers callbacks to it, and RTC1
+//  when it keeps time with the RTC
+__attribute__((weak)) void SWI1_EGU1_IRQHandler(void) {
+}
+
+__attribute__((weak)) void RTC1_IRQHandler(void) {
+}
+
+static void injected_irq_handler(void) {
+  void (*handler)(void) = injected_handler;
+  injected_handler = NULL;
+  if (handler != NULL) {
+    handler();
+  }
+}
+
+static void (*const handlers[SIM_IRQ_COUNT])(void) = {
+  [RTC1_IRQn] = RTC1_IRQHandler,
+  [SWI1_EGU1_IRQn] = SWI1_EGU1_IRQHandler,
+  [TIMER4_IRQn] = TIMER4_IRQHandler,
+  [SIM_INJECTED_IRQn] = injected_irq_handler,
+};
+
+
+// -- Peripheral behaviour
+
+// Act on register writes made since the last access
+static void poll_timer4(void) {
+  timer4.touched = false;
+  NRF_TIMER_Type* t = &timer4.regs;
+  if (t->INTENSET) {
+    timer4.inten |= t->INTENSET;
+    t->INTENSET = 0;
+  }
+  if (t->INTENCLR) {
+    timer4.inten &= ~t->INTENCLR;
+    t->INTENCLR = 0;
+  }
+  if (t->TASKS_CLEAR) {
+    t->TASKS_CLEAR = 0;
+    timer4.counter = 0;
+  }
+  if (t->TASKS_START) {
+    t->TASKS_START = 0;
+    if (!timer4.running) {
+      timer4_starts++;
+    }
+    timer4.running = true;
+  }
+  if (t->TASKS_STOP) {
+    t->TASKS_STOP = 0;
+    timer4.running = false;
+  }
+  for (uint32_t i = 0; i < 6; i++) {
+    if (t->TASKS_CAPTURE[i]) {
+      t->TASKS_CAPTURE[i] = 0;
+      t->CC[i] = timer4.counter;
+    }
+  }
+}
+
+static void poll_egu1(void) {
+  egu1.touched = false;
+  NRF_EGU_Type* e = &egu1.regs;
+  if (e->INTENSET) {
+    egu1.inten |= e->INTENSET;
+    e->INTENSET = 0;
+  }
+  if (e->INTENCLR) {
+    egu1.inten &= ~e->INTENCLR;
+    e->INTENCLR = 0;
+  }
+  for (uint32_t i = 0; i < 16; i++) {
+    if (e->TASKS_TRIGGER[i]) {
+      e->TASKS_TRIGGER[i] = 0;
+      e->EVENTS_TRIGGERED[i] = 1;
+      if (egu1.inten & (1u << i)) {
+        irq_pending |= 1ull << SWI1_EGU1_IRQn;
+      }
+    }
+  }
+}
+
+// -- RTC1 and PPI
+
+#define RTC_MASK 0xFFFFFFu
+#define NO_TICK UINT64_MAX
+
+// Microsecond of LFCLK tick <tick>, and the latest tick at or before <us>
+static uint64_t tick_time_us(uint64_t tick) {
+  return (tick * 15625) >> 9;
+}
+
+static uint64_t tick_at_us(uint64_t us) {
+  return ((us + 1) * 512 - 1) / 15625;
+}
+
+static uint64_t current_tick(void) {
+  return tick_at_us(time_ns / 1000);
+}
+
+static uint32_t rtc_counter(uint64_t tick) {
+  return rtc1.running ? (uint32_t)(tick - rtc1.origin) & RTC_MASK : rtc1.stopped_counter;
+}
+
+// Run the task at <address>, if it is a TIMER4 task
+static void ppi_task(uint32_t address) {
+  uint32_t base = (uint32_t)(uintptr_t)&timer4.regs;
+  if (address - base < sizeof(NRF_TIMER_Type)) {
+    *(volatile uint32_t*)((uint8_t*)&timer4.regs + (address - base)) = 1;
+    poll_timer4();
+  }
+}
+
+// Pass the event at <address> to the tasks of the enabled PPI channels
+static void ppi_event(volatile uint32_t* event) {
+  uint32_t address = (uint32_t)(uintptr_t)event;
+  for (uint32_t channel = 0; channel < 20; channel++) {
+    if ((ppi.chen & (1u << channel)) && ppi.regs.CH[channel].EEP == address) {
+      ppi_task(ppi.regs.CH[channel].TEP);
+      if (ppi.regs.FORK[channel].TEP != 0) {
+        ppi_task(ppi.regs.FORK[channel].TEP);
+      }
+    }
+  }
+}
+
+static void poll_ppi(void) {
+  ppi.touched = false;
+  if (ppi.regs.CHENSET) {
+    ppi.chen |= ppi.regs.CHENSET;
+    ppi.regs.CHENSET = 0;
+  }
+  if (ppi.regs.CHENCLR) {
+    ppi.chen &= ~ppi.regs.CHENCLR;
+    ppi.regs.CHENCLR = 0;
+  }
+  ppi.regs.CHEN = ppi.chen;
+}
+
+static void poll_rtc1(void) {
+  rtc1.touched = false;
+  NRF_RTC_Type* r = &rtc1.regs;
+  uint64_t tick = current_tick();
+  if (r->INTENSET) {
+    rtc1.inten |= r->INTENSET;
+    r->INTENSET = 0;
+  }
+  if (r->INTENCLR) {
+    rtc1.inten &= ~r->INTENCLR;
+    r->INTENCLR = 0;
+  }
+  if (r->EVTENSET) {
+    rtc1.evten |= r->EVTENSET;
+    r->EVTENSET = 0;
+  }
+  if (r->EVTENCLR) {
+    rtc1.evten &= ~r->EVTENCLR;
+    r->EVTENCLR = 0;
+  }
+  r->EVTEN = rtc1.evten;
+  if (r->TASKS_STOP) {
+    r->TASKS_STOP = 0;
+    rtc1.stopped_counter = rtc_counter(tick);
+    rtc1.running = false;
+  }
+  if (r->TASKS_CLEAR) {
+    r->TASKS_CLEAR = 0;
+    rtc1.origin = tick;
+    rtc1.stopped_counter = 0;
+  }
+  if (r->TASKS_START) {
+    r->TASKS_START = 0;
+    if (!rtc1.running) {
+      rtc1.origin = tick - rtc1.stopped_counter;
+      rtc1.running = true;
+    }
+  }
+
+  // a compare written too close to the counter may not fire
+  for (uint32_t i = 0; i < 4; i++) {
+    if (r->CC[i] != rtc1.cc_seen[i]) {
+      r->CC[i] &= RTC_MASK;
+      rtc1.cc_seen[i] = r->CC[i];
+      rtc1.armed_tick[i] = tick + 2;
+    }
+  }
+}
+
+// First tick after the current one on which RTC1 raises an event that is
+//  routed to an interrupt or to PPI, or NO_TICK
+static uint64_t rtc_next_event_tick(void) {
+  if (!rtc1.running) {
+    return NO_TICK;
+  }
+  uint64_t now = current_tick();
+  uint64_t next = NO_TICK;
+  for (uint32_t i = 0; i < 4; i++) {
+    uint32_t bit = 1u << (16 + i);
+    if (((rtc1.inten | rtc1.evten) & bit) == 0) {
+      continue;
+    }
+    uint64_t from = (rtc1.armed_tick[i] > now + 1) ? rtc1.armed_tick[i] : now + 1;
+    uint64_t tick = from + ((rtc1.regs.CC[i] - rtc_counter(from)) & RTC_MASK);
+    if (tick < next) {
+      next = tick;
+    }
+  }
+  if (rtc1.inten & RTC_INTENSET_OVRFLW_Msk) {
+    uint64_t tick = now + 1 + ((0 - rtc_counter(now + 1)) & RTC_MASK);
+    if (tick < next) {
+      next = tick;
+    }
+  }
+  return next;
+}
+
+// Raise the events of RTC1 for <tick>, which has just happened
+static void rtc_tick_events(uint64_t tick) {
+  uint32_t counter = rtc_counter(tick);
+  if (counter == 0) {
+    rtc1.regs.EVENTS_OVRFLW = 1;
+    if (rtc1.inten & RTC_INTENSET_OVRFLW_Msk) {
+      irq_pending |= 1ull << RTC1_IRQn;
+    }
+  }
+  for (uint32_t i = 0; i < 4; i++) {
+    if (rtc1.regs.CC[i] != counter || tick < rtc1.armed_tick[i]) {
+      continue;
+    }
+    uint32_t bit = 1u << (16 + i);
+    rtc1.regs.EVENTS_COMPARE[i] = 1;
+    if (rtc1.inten & bit) {
+      irq_pending |= 1ull << RTC1_IRQn;
+    }
+    if (rtc1.evten & bit) {
+      ppi_event(&rtc1.regs.EVENTS_COMPARE[i]);
+    }
+  }
+}
+
+static void poll_peripherals(void) {
+  if (timer4.touched) {
+    poll_timer4();
+  }
+  if (egu1.touched) {
+    poll_egu1();
+  }
+  if (ppi.touched) {
+    poll_ppi();
+  }
+  if (rtc1.touched) {
+    poll_rtc1();
+  }
+}
+
+// Run pending interrupts that may preempt the current code, highest priority
+//  first. Handlers can make other interrupts pending, so keep going until
+//  none are left
+static void deliver_interrupts(void) {
+  while (primask == 0 && irq_pending != 0) {
+    int32_t next = -1;
+    for (int32_t irq = 0; irq < SIM_IRQ_COUNT; irq++) {
+      if ((irq_pending & (1ull << irq)) && irq_enabled[irq] && irq_priority[irq] < execution_priority &&
+          (next < 0 || irq_priority[irq] < irq_priority[next])) {
+        next = irq;
+      }
+    }
+    if (next < 0) {
+      return;
+    }
+
+    irq_pending &= ~(1ull << next);
+    uint32_t saved_priority = execution_priority;
+    execution_priority = irq_priority[next];
+    handlers[next]();
+    poll_peripherals();
+    execution_priority = saved_priority;
+  }
+}
+
+// Distance in microseconds until the counter next reaches a CC value that has
+//  its interrupt enabled
+static uint64_t next_compare_distance(void) {
+  uint64_t distance = UINT64_MAX;
+  for (uint32_t i = 0; i < 6; i++) {
+    if ((timer4.inten & (1u << (TIMER_INTENSET_COMPARE0_Pos + i))) == 0) {
+      continue;
+    }
+    uint64_t d = (uint32_t)(timer4.regs.CC[i] - timer4.counter);
+    if (d == 0) {
+      d = 1ull << 32;
+    }
+    if (d < distance) {
+      distance = d;
+    }
+  }
+  return distance;
+}
+
+// Move time forward to <target_ns>, stopping at every TIMER4 compare match
+//  and RTC1 event to raise its events and run the interrupt handler. Handlers
+//  may move time further through access costs
+static void advance_to(uint64_t target_ns) {
+  while (time_ns < target_ns) {
+    uint64_t now_us = time_ns / 1000;
+    uint64_t target_us = target_ns / 1000;
+    if (target_us == now_us) {
+      time_ns = target_ns;
+      return;
+    }
+
+    uint64_t compare_us = timer4.running ? now_us + next_compare_distance() : UINT64_MAX;
+    uint64_t rtc_tick = rtc_next_event_tick();
+    uint64_t rtc_us = (rtc_tick == NO_TICK) ? UINT64_MAX : tick_time_us(rtc_tick);
+    uint64_t event_us = (compare_us < rtc_us) ? compare_us : rtc_us;
+    if (event_us > target_us) {
+      if (timer4.running) {
+        timer4.counter += target_us - now_us;
+      }
+      time_ns = target_ns;
+      return;
+    }
+
+    // stop exactly on the event
+    uint32_t old_counter = timer4.counter;
+    uint64_t distance = event_us - now_us;
+    if (timer4.running) {
+      timer4.counter += distance;
+    }
+    time_ns = event_us * 1000;
+    if (compare_us == event_us) {
+      for (uint32_t i = 0; i < 6; i++) {
+        // every channel matching on the way raises its event, enabled or not
+        if ((uint32_t)(timer4.regs.CC[i] - old_counter - 1) < distance) {
+          timer4.regs.EVENTS_COMPARE[i] = 1;
+          if (timer4.inten & (1u << (TIMER_INTENSET_COMPARE0_Pos + i))) {
+            irq_pending |= 1ull << TIMER4_IRQn;
+          }
+        }
+      }
+    }
+    if (rtc_us == event_us) {
+      rtc_tick_events(rtc_tick);
+    }
+    deliver_interrupts();
+  }
+}
+
+// Every access to the simulated hardware goes through here
+static void access(void) {
+  poll_peripherals();
+  access_count++;
+  // the counter only changes on whole microseconds
+  if (time_ns % 1000 + access_cost_ns < 1000) {
+    time_ns += access_cost_ns;
+  } else {
+    advance_to(time_ns + access_cost_ns);
+  }
+
+  if (inject_countdown != 0 && --inject_countdown == 0) {
+    irq_pending |= 1ull << SIM_INJECTED_IRQn;
+  }
+  if (irq_pending != 0) {
+    deliver_interrupts();
+  }
+}
+
+
+// -- Peripheral and CMSIS stand-ins
+
+NRF_TIMER_Type* sim_timer4(void) {
+  access();
+  timer4.touched = true;
+  return &timer4.regs;
+}
+
+NRF_EGU_Type* sim_egu1(void) {
+  access();
+  egu1.touched = true;
+  return &egu1.regs;
+}
+
+NRF_RTC_Type* sim_rtc1(void) {
+  access();
+  rtc1.touched = true;
+  rtc1.regs.COUNTER = rtc_counter(current_tick());
+  return &rtc1.regs;
+}
+
+// The low frequency clock starts straight away
+NRF_CLOCK_Type* sim_clock(void) {
+  access();
+  if (clock_regs.TASKS_LFCLKSTART) {
+    clock_regs.TASKS_LFCLKSTART = 0;
+    clock_regs.EVENTS_LFCLKSTARTED = 1;
+    clock_regs.LFCLKSTAT = CLOCK_LFCLKSTAT_STATE_Msk;
+  }
+  return &clock_regs;
+}
+
+NRF_PPI_Type* sim_ppi(void) {
+  access();
+  ppi.touched = true;
+  return &ppi.regs;
+}
+
+DWT_Type* sim_dwt(void) {
+  access();
+  dwt.CYCCNT = (uint32_t)(time_ns * CPU_MHZ / 1000);
+  return &dwt;
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+  irq_enabled[irq] = true;
+  access();
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+  access();
+  irq_enabled[irq] = false;
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {
+  access();
+  irq_priority[irq] = priority;
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type irq) {
+  irq_pending |= 1ull << irq;
+  access();
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq) {
+  access();
+  irq_pending &= ~(1ull << irq);
+}
+
+uint32_t __get_PRIMASK(void) {
+  access();
+  return primask;
+}
+
+void __set_PRIMASK(uint32_t value) {
+  access();
+  primask = value & 1;
+  deliver_interrupts();
+}
+
+void __disable_irq(void) {
+  access();
+  primask = 1;
+}
+
+void __enable_irq(void) {
+  __set_PRIMASK(0);
+}
+
+void __DMB(void) {
+  access();
+}
+
+
+// -- Simulation control
+
+void sim_reset(void) {
+  time_ns = 0;
+  access_cost_ns = 0;
+  access_count = 0;
+  memset(&timer4, 0, sizeof(timer4));
+  memset(&egu1, 0, sizeof(egu1));
+  memset(&rtc1, 0, sizeof(rtc1));
+  memset(&clock_regs, 0, sizeof(clock_regs));
+  memset(&ppi, 0, sizeof(ppi));
+  timer4_starts = 0;
+  memset(&dwt, 0, sizeof(dwt));
+  memset(&sim_core_debug, 0, sizeof(sim_core_debug));
+  memset(irq_enabled, 0, sizeof(irq_enabled));
+  irq_pending = 0;
+  memset(irq_priority, 0, sizeof(irq_priority));
+  irq_enabled[SIM_INJECTED_IRQn] = true;
+  primask = 0;
+  execution_priority = THREAD_PRIORITY;
+  injected_handler = NULL;
+  inject_countdown = 0;
+}
+
+uint64_t sim_time_us(void) {
+  return time_ns / 1000;
+}
+
+void sim_advance(uint64_t microseconds) {
+  poll_peripherals();
+  advance_to(time_ns + microseconds * 1000);
+  deliver_interrupts();
+}
+
+void sim_set_access_cost(uint32_t nanoseconds) {
+  access_cost_ns = nanoseconds;
+}
+
+uint64_t sim_accesses(void) {
+  return access_count;
+}
+
+void sim_inject_interrupt(uint32_t accesses, void (*handler)(void), uint32_t priority) {
+  injected_handler = handler;
+  irq_priority[SIM_INJECTED_IRQn] = priority;
+  inject_countdown = accesses == 0 ? 1 : accesses;
+}
+
+bool sim_in_interrupt(void) {
+  return execution_priority != THREAD_PRIORITY;
+}
+
+uint32_t sim_timer4_starts(void) {
+  return timer4_starts;
+}
+
+uint64_t sim_rtc_tick_time_us(uint64_t tick) {
+  return tick_time_us(tick);
+}
+
+uint64_t sim_rtc_ticks(void) {
+  return current_tick();
+}
@@ -0,0 +1,48 @@
+// Simulated nRF52833 peripherals for host builds
+//
+// TIMER4, RTC1, PPI, the low frequency clock, EGU1, the DWT cycle counter and
+//  the NVIC are simulated well enough to run virtual_timer.c unmodified.
+//  Simulated time only moves when asked to, or by a fixed cost per peripheral
+//  access, so every run is deterministic.
+//
+// Every peripheral access and every CMSIS call is an "access". Pending
+//  interrupts are delivered at accesses, the same way real interrupts land
+//  between instructions, and only when PRIMASK and priorities allow.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "nrf.h"
+
+// Reset every simulated peripheral and set the time to 0
+void sim_reset(void);
+
+// Current simulated time in microseconds
+uint64_t sim_time_us(void);
+
+// Move simulated time forward by <microseconds>, running interrupt handlers
+//  at the exact times their events happen
+void sim_advance(uint64_t microseconds);
+
+// Set how many nanoseconds of simulated time each access takes. With 0, time
+//  stands still while code runs
+void sim_set_access_cost(uint32_t nanoseconds);
+
+// Number of accesses since sim_reset()
+uint64_t sim_accesses(void);
+
+// Make SIM_INJECTED_IRQn pending after <accesses> more accesses, which runs
+//  <handler> at <priority> as soon as PRIMASK and priorities allow
+void sim_inject_interrupt(uint32_t accesses, void (*handler)(void), uint32_t priority);
+
+// Returns true while an interrupt handler is running
+bool sim_in_interrupt(void);
+
+// Number of times TIMER4 was started, by code or through PPI
+uint32_t sim_timer4_starts(void);
+
+// Number of 32.768 kHz ticks since sim_reset(), and the microsecond on which
+//  tick <tick> happens
+uint64_t sim_rtc_ticks(void);
+uint64_t sim_rtc_tick_time_us(uint64_t tick);
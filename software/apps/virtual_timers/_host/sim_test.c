@@ -0,0 +1,530 @@
+// Virtual timer library test on simulated hardware
+//
+// Runs the unmodified virtual_timer.c against the simulated TIMER4 from
+//  sim_nrf.c and checks every expiry against a model of the running timers:
+//  - exact:  code runs in a tiny fraction of a microsecond, so every timer
+//            must fire on exactly the microsecond it was scheduled for
+//  - slack:  timers with slack fire inside their window, and timers whose
+//            windows overlap share an interrupt
+//  - load:   many repeated timers, to measure expiries per second of host time
+//  - races:  code takes time to run and other interrupts that start and cancel
+//            timers land at random points, including inside virtual_timer_start()
+//            and virtual_timer_cancel(). Timers may then be a little late, but
+//            never early, never lost and never run after being cancelled
+//  - wrap:   the exact test again while the 32-bit counter wraps around
+//  - cancel: with callbacks deferred to the main loop, timers cancelled after
+//            they expired but before their callback ran must not run
+//  - rtc:    with the RTC clock, a deadline on the tick TIMER4 starts on and
+//            one before it are woken up by the RTC, and TIMER4 is restarted
+//            every PRECISE_RESYNC_US without timers going off early or late
+//
+// With the RTC clock, timers started close to their deadline while TIMER4 is
+//  stopped may be up to RTC_TOLERANCE_US late, and the wrap test runs while
+//  the 24-bit RTC counter wraps instead
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nrf.h"
+#include "sim_nrf.h"
+#include "virtual_timer.h"
+#include "virtual_timer_pool.h"
+
+#define SLOTS 32
+#define EXACT_STEPS 200000
+#define RACE_STEPS 200000
+#define DEFERRED_STEPS 20000
+#define SLACK_STEPS 200000
+#define LOAD_SECONDS 20
+#define MAX_DELAY 5000
+
+// a broken library tends to loop forever, so give up after this long
+#define WATCHDOG_SECONDS 120
+
+// how late a timer may run in the exact test. Deferred callbacks wait for the
+//  whole timer interrupt, which may also handle deadlines a few microseconds
+//  later
+#if VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_IMMEDIATE
+#define EXACT_TOLERANCE_US 0
+#else
+#define EXACT_TOLERANCE_US 10
+#endif
+
+// Priority of injected interrupts. A callback that is being dispatched when its
+//  timer is cancelled from a higher priority interrupt still runs, which the
+//  model cannot tell apart from a lost cancel. Injected interrupts therefore
+//  share the SWI priority when callbacks are deferred to it
+#if VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_SWI
+#define INJECTED_PRIORITY 7
+#else
+#define INJECTED_PRIORITY 3
+#endif
+
+// how late a timer may run in the race test, from code taking time and from
+//  injected interrupts holding off the timer interrupt
+#define RACE_TOLERANCE_US 100
+
+// The RTC wakes up at least three ticks ahead, so a deadline TIMER4 cannot
+//  catch may be up to four ticks late
+#define RTC_TOLERANCE_US 123
+
+// Must match virtual_timer.c
+#define PRECISE_START_TICKS 2
+#define PRECISE_RESYNC_US 1000000
+
+// Repeated timer period for the resync test, short enough that TIMER4 keeps
+//  running between expiries
+#define RESYNC_PERIOD_US 300
+
+#if VIRTUAL_TIMER_CLOCK == VIRTUAL_TIMER_CLOCK_RTC
+#undef EXACT_TOLERANCE_US
+#define EXACT_TOLERANCE_US RTC_TOLERANCE_US
+#undef RACE_TOLERANCE_US
+#define RACE_TOLERANCE_US (100 + RTC_TOLERANCE_US)
+#endif
+
+typedef enum {
+  SLOT_FREE,
+  SLOT_ACTIVE,
+  SLOT_CANCELLING,
+} slot_state_t;
+
+// Model of one running timer. Its first expiry is known to lie between
+//  `earliest` and `latest`, since the library reads the time somewhere inside
+//  virtual_timer_start()
+typedef struct {
+  slot_state_t state;
+  uint32_t id;
+  uint32_t period;
+  uint64_t earliest;
+  uint64_t latest;
+} slot_t;
+
+static slot_t slots[SLOTS];
+static uint32_t tolerance_us = 0;
+static uint64_t expiries = 0;
+static bool failed = false;
+
+// xorshift32, so every run does the same thing
+static uint32_t rng_state = 0x12345678;
+static uint32_t rng(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+static void fail(const char* message, uint32_t slot) {
+  if (!failed) {
+    printf("ERROR: %s (slot %u at %llu us, expected %llu us)\n", message, slot,
+        (unsigned long long)sim_time_us(), (unsigned long long)slots[slot].earliest);
+  }
+  failed = true;
+}
+
+
+// -- Callbacks
+//
+// Callbacks take no arguments, so each slot gets its own
+
+static void fired(uint32_t index) {
+  slot_t* slot = &slots[index];
+  uint64_t now = virtual_timer_read_time64();
+  expiries++;
+
+  if (slot->state == SLOT_FREE) {
+    fail("timer fired while not running", index);
+    return;
+  }
+  if (now < slot->earliest) {
+    fail("timer fired early", index);
+  }
+  if (now > slot->latest + tolerance_us) {
+    fail("timer fired late", index);
+  }
+
+  if (slot->period != 0) {
+    // lateness does not carry over to the next expiry
+    slot->earliest += slot->period;
+    slot->latest += slot->period;
+  } else if (slot->state == SLOT_ACTIVE) {
+    slot->state = SLOT_FREE;
+  }
+}
+
+// Callback <group>_<n> serves slot <group> * 8 + <n>
+#define CALLBACK(group, n) static void callback_##group##_##n(void) { fired(group * 8 + n); }
+#define CALLBACKS_8(group) CALLBACK(group, 0) CALLBACK(group, 1) CALLBACK(group, 2) CALLBACK(group, 3) \
+    CALLBACK(group, 4) CALLBACK(group, 5) CALLBACK(group, 6) CALLBACK(group, 7)
+CALLBACKS_8(0) CALLBACKS_8(1) CALLBACKS_8(2) CALLBACKS_8(3)
+#undef CALLBACK
+
+#define CALLBACK(group, n) callback_##group##_##n,
+static const virtual_timer_callback_t callbacks[SLOTS] = {
+  CALLBACKS_8(0) CALLBACKS_8(1) CALLBACKS_8(2) CALLBACKS_8(3)
+};
+
+
+// -- Operations on the model and the library
+
+// The library reads the time somewhere inside virtual_timer_start(). The exact
+//  test takes under 1 us per call, so allow for one microsecond boundary
+//  until the call returns and the real window is known
+static void start_timer(uint32_t index, uint32_t delay, bool repeated) {
+  slot_t* slot = &slots[index];
+  slot->state = SLOT_ACTIVE;
+  slot->id = 0;
+  slot->period = repeated ? delay : 0;
+  uint64_t before = virtual_timer_read_time64();
+  slot->earliest = before + delay;
+  slot->latest = slot->earliest + 1;
+
+  uint32_t id = repeated ? virtual_timer_start_repeated(delay, callbacks[index])
+                         : virtual_timer_start(delay, callbacks[index]);
+  if (id == 0) {
+    fail("pool exhausted", index);
+  }
+
+  // a short one-shot timer may already have fired
+  if (slot->state == SLOT_ACTIVE) {
+    slot->id = id;
+    slot->latest += virtual_timer_read_time64() - before - 1;
+  }
+}
+
+// Start a one-shot timer that may fire up to <slack> microseconds late
+static void start_timer_with_slack(uint32_t index, uint32_t delay, uint32_t slack) {
+  slot_t* slot = &slots[index];
+  slot->state = SLOT_ACTIVE;
+  slot->id = 0;
+  slot->period = 0;
+  uint64_t before = virtual_timer_read_time64();
+  slot->earliest = before + delay;
+  slot->latest = slot->earliest + slack + 1;
+
+  uint32_t id = virtual_timer_start_with_slack(delay, slack, callbacks[index]);
+  if (id == 0) {
+    fail("pool exhausted", index);
+  }
+  if (slot->state == SLOT_ACTIVE) {
+    slot->id = id;
+    slot->latest += virtual_timer_read_time64() - before - 1;
+  }
+}
+
+static void cancel_timer(uint32_t index) {
+  slot_t* slot = &slots[index];
+  slot->state = SLOT_CANCELLING;
+  virtual_timer_cancel(slot->id);
+  slot->state = SLOT_FREE;
+  slot->id = 0;
+}
+
+// Start a timer in a free slot or cancel a running one, picking from <count>
+//  slots starting at <first>
+static void random_operation(uint32_t first, uint32_t count, uint32_t min_delay) {
+  uint32_t index = first + rng() % count;
+  slot_t* slot = &slots[index];
+  if (slot->state == SLOT_FREE) {
+    // repeated timers need a period the library can keep up with
+    bool repeated = (rng() % 4) == 0;
+    uint32_t delay = min_delay + rng() % MAX_DELAY;
+    if (repeated && delay < 50) {
+      delay += 50;
+    }
+    start_timer(index, delay, repeated);
+  } else if (slot->state == SLOT_ACTIVE && slot->id != 0) {
+    cancel_timer(index);
+  }
+}
+
+static void cancel_all(void) {
+  for (uint32_t i = 0; i < SLOTS; i++) {
+    if (slots[i].state == SLOT_ACTIVE) {
+      cancel_timer(i);
+    }
+  }
+}
+
+static void check_pool(void) {
+  uint32_t running = 0;
+  for (uint32_t i = 0; i < SLOTS; i++) {
+    running += (slots[i].state != SLOT_FREE);
+  }
+  if (pool_used() != running) {
+    printf("ERROR: %u timers allocated, %u running\n", pool_used(), running);
+    failed = true;
+  }
+}
+
+// Injected interrupts use their own half of the slots, so that the model never
+//  sees a slot change under the code that is updating it
+static void injected_operation(void) {
+  random_operation(SLOTS / 2, SLOTS / 2, 0);
+}
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+// -- Tests
+
+static void run_exact(const char* name) {
+  uint64_t start_expiries = expiries;
+  // the library waits for the clock when a deadline is under 1 us away, so
+  //  time cannot stand still completely
+  sim_set_access_cost(1);
+  tolerance_us = EXACT_TOLERANCE_US;
+  for (uint32_t step = 0; step < EXACT_STEPS && !failed; step++) {
+    random_operation(0, SLOTS, 0);
+    sim_advance(rng() % 200);
+    check_pool();
+  }
+  printf("%-6s %s, %llu expiries\n", name, failed ? "FAILED" : "ok",
+      (unsigned long long)(expiries - start_expiries));
+}
+
+static void run_load(void) {
+  sim_set_access_cost(1);
+  tolerance_us = EXACT_TOLERANCE_US;
+  cancel_all();
+  for (uint32_t i = 0; i < SLOTS; i++) {
+    start_timer(i, 100 + rng() % 1000, true);
+  }
+
+  uint64_t start_expiries = expiries;
+  uint64_t start_accesses = sim_accesses();
+  double start = seconds();
+  for (uint32_t ms = 0; ms < LOAD_SECONDS * 1000 && !failed; ms++) {
+    sim_advance(1000);
+  }
+  double elapsed = seconds() - start;
+  uint64_t count = expiries - start_expiries;
+  if (count == 0) {
+    printf("ERROR: no timers expired\n");
+    failed = true;
+    return;
+  }
+  printf("load   %s, %llu expiries, %.2f million per second, %llu accesses each\n", failed ? "FAILED" : "ok",
+      (unsigned long long)count, count / elapsed / 1e6, (unsigned long long)((sim_accesses() - start_accesses) / count));
+  cancel_all();
+}
+
+// Timers with slack fire inside their window, and timers whose windows overlap
+//  share one interrupt
+static void run_slack(void) {
+  sim_set_access_cost(1);
+  tolerance_us = EXACT_TOLERANCE_US;
+  cancel_all();
+
+  // windows [100, 110] and [105, 130] overlap in 105..110
+  uint32_t before = virtual_timer_coalesced_interrupts();
+  start_timer_with_slack(0, 100, 10);
+  start_timer_with_slack(1, 105, 25);
+  sim_advance(200);
+  if (virtual_timer_coalesced_interrupts() != before + 1) {
+    printf("ERROR: overlapping slack windows were not coalesced\n");
+    failed = true;
+  }
+
+  uint64_t start_expiries = expiries;
+  uint32_t start_coalesced = virtual_timer_coalesced_interrupts();
+  for (uint32_t step = 0; step < SLACK_STEPS && !failed; step++) {
+    uint32_t index = rng() % SLOTS;
+    if (slots[index].state == SLOT_FREE) {
+      start_timer_with_slack(index, rng() % MAX_DELAY, rng() % 500);
+    }
+    sim_advance(rng() % 50);
+    check_pool();
+  }
+  sim_advance(MAX_DELAY + 1000);
+  printf("slack  %s, %llu expiries, %u interrupts saved\n", failed ? "FAILED" : "ok",
+      (unsigned long long)(expiries - start_expiries), virtual_timer_coalesced_interrupts() - start_coalesced);
+}
+
+static void run_races(void) {
+  uint64_t start_expiries = expiries;
+  sim_set_access_cost(20);
+  tolerance_us = RACE_TOLERANCE_US;
+  for (uint32_t step = 0; step < RACE_STEPS && !failed; step++) {
+    sim_inject_interrupt(1 + rng() % 64, injected_operation, INJECTED_PRIORITY);
+    random_operation(0, SLOTS / 2, 0);
+    sim_advance(rng() % 200);
+    check_pool();
+  }
+  printf("races  %s, %llu expiries\n", failed ? "FAILED" : "ok",
+      (unsigned long long)(expiries - start_expiries));
+
+  if (!failed) {
+    // finish any injection that is still pending before going on
+    sim_advance(1000);
+    cancel_all();
+  }
+}
+
+#if VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_MAIN
+
+// Callbacks deferred to the main loop wait in the queue until it runs them.
+//  Cancelling a timer whose callback is waiting must stop the callback, even
+//  once the node is freed and reused by a new timer in the same slot
+static void run_deferred_cancel(void) {
+  uint64_t start_expiries = expiries;
+  sim_set_access_cost(1);
+  tolerance_us = UINT32_MAX;
+  for (uint32_t step = 0; step < DEFERRED_STEPS && !failed; step++) {
+    // every timer expires and queues its callback
+    for (uint32_t i = 0; i < SLOTS; i++) {
+      start_timer(i, 1 + rng() % 200, false);
+    }
+    sim_advance(300);
+
+    // cancel some of them and reuse their nodes for timers that stay running
+    for (uint32_t i = 0; i < SLOTS; i++) {
+      if (rng() % 2) {
+        cancel_timer(i);
+        start_timer(i, 1000, false);
+      }
+    }
+
+    // only the callbacks of timers that were not cancelled may run
+    virtual_timer_run_callbacks();
+    cancel_all();
+    virtual_timer_run_callbacks();
+    check_pool();
+  }
+  printf("cancel %s, %llu expiries\n", failed ? "FAILED" : "ok",
+      (unsigned long long)(expiries - start_expiries));
+}
+
+#endif
+
+#if VIRTUAL_TIMER_CLOCK == VIRTUAL_TIMER_CLOCK_RTC
+
+// Stop every timer and wait until TIMER4 is stopped and the RTC has just
+//  ticked
+static void rtc_idle(void) {
+  cancel_all();
+  sim_advance(10000);
+  sim_advance(sim_rtc_tick_time_us(sim_rtc_ticks() + 1) - sim_time_us());
+}
+
+// Start a one-shot timer <ticks> RTC ticks plus <extra_us> after the current
+//  tick, and check that it fires no more than RTC_TOLERANCE_US late
+static void rtc_one_shot(const char* what, uint32_t ticks, uint32_t extra_us) {
+  rtc_idle();
+  tolerance_us = RTC_TOLERANCE_US;
+  uint64_t tick = sim_rtc_ticks();
+  uint32_t delay = sim_rtc_tick_time_us(tick + ticks) - sim_rtc_tick_time_us(tick) + extra_us;
+  start_timer(0, delay, false);
+  sim_advance(RTC_TOLERANCE_US + delay + 1000);
+  if (slots[0].state != SLOT_FREE) {
+    printf("ERROR: timer %s never fired\n", what);
+    failed = true;
+  }
+}
+
+static void run_rtc(void) {
+  sim_set_access_cost(1);
+  uint64_t start_expiries = expiries;
+
+  // TIMER4 starts counting from 0 on the tick PRECISE_START_TICKS ahead of
+  //  now, so it cannot catch a deadline on that tick or before it
+  rtc_one_shot("on the TIMER4 start tick", PRECISE_START_TICKS, 0);
+  rtc_one_shot("before the TIMER4 start tick", 0, 20);
+
+  // close deadlines keep TIMER4 running, and it is restarted on an RTC tick
+  //  every PRECISE_RESYNC_US. Timers must still fire on the exact microsecond
+  rtc_idle();
+  tolerance_us = 0;
+  uint32_t starts = sim_timer4_starts();
+  start_timer(0, RESYNC_PERIOD_US, true);
+  for (uint32_t ms = 0; ms < 5 * PRECISE_RESYNC_US / 2000 && !failed; ms++) {
+    sim_advance(1000);
+  }
+  cancel_all();
+  if (sim_timer4_starts() - starts < 3) {
+    printf("ERROR: TIMER4 was started %u times, expected a resync every %u us\n",
+        sim_timer4_starts() - starts, PRECISE_RESYNC_US);
+    failed = true;
+  }
+
+  printf("rtc    %s, %llu expiries, %u TIMER4 starts\n", failed ? "FAILED" : "ok",
+      (unsigned long long)(expiries - start_expiries), sim_timer4_starts() - starts);
+}
+
+#endif
+
+static void watchdog(int signal) {
+  static const char message[] = "ERROR: timed out\n";
+  write(STDOUT_FILENO, message, sizeof(message) - 1);
+  _exit(1);
+}
+
+int main(void) {
+  setvbuf(stdout, NULL, _IONBF, 0);
+  signal(SIGALRM, watchdog);
+  alarm(WATCHDOG_SECONDS);
+
+  sim_reset();
+  virtual_timer_init();
+
+  printf("%s backend, %s callbacks, %s clock\n",
+      VIRTUAL_TIMER_BACKEND == VIRTUAL_TIMER_BACKEND_WHEEL ? "wheel" : "list",
+      VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_SWI ? "SWI" :
+      VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_MAIN ? "main loop" : "immediate",
+      VIRTUAL_TIMER_CLOCK == VIRTUAL_TIMER_CLOCK_RTC ? "RTC" : "TIMER");
+
+#if VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_MAIN
+  // the other tests expect callbacks to run without the main loop
+  run_deferred_cancel();
+  return failed ? 1 : 0;
+#endif
+
+  // later tests are not run once the library is in a bad state
+  run_exact("exact");
+  if (!failed) {
+    run_slack();
+  }
+  if (!failed) {
+    run_load();
+  }
+  if (!failed) {
+    run_races();
+  }
+#if VIRTUAL_TIMER_CLOCK == VIRTUAL_TIMER_CLOCK_RTC
+  if (!failed) {
+    run_rtc();
+  }
+  if (!failed) {
+    // move to a little before the 24-bit RTC counter wraps
+    uint64_t wrap_ticks = (sim_rtc_ticks() | 0xFFFFFF) + 1;
+    rtc_idle();
+    sim_advance(sim_rtc_tick_time_us(wrap_ticks) - sim_time_us() - 5000000);
+    run_exact("wrap");
+    if (sim_rtc_ticks() < wrap_ticks) {
+      printf("ERROR: RTC counter did not wrap\n");
+      failed = true;
+    }
+  }
+#else
+  if (!failed) {
+    // move to a little before the 32-bit counter wraps
+    sim_advance((1ull << 32) - (sim_time_us() & 0xFFFFFFFF) - 5000000);
+    run_exact("wrap");
+    if (sim_time_us() < (1ull << 32)) {
+      printf("ERROR: counter did not wrap\n");
+      failed = true;
+    }
+  }
+#endif
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+// Virtual timer backend benchmark
+//
+// Compares the sorted linked list and the timing wheel as the number of
+//  pending timers grows. Every timer is always pending: each step moves time
+//  forward, re-arms any timers that expired, then cancels a random timer and
+//  starts it again with a new deadline. This is the same work the virtual
+//  timer library does with interrupts disabled.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "virtual_timer_linked_list.h"
+#include "virtual_timer_wheel.h"
+
+#define STEPS 50000
+#define MAX_DELAY 1000000
+#define MAX_TIME_STEP 20
+
+typedef struct {
+  const char* name;
+  void (*init)(uint64_t now);
+  void (*insert)(node_t* node, uint64_t now);
+  void (*remove)(node_t* node);
+  node_t* (*remove_expired)(uint64_t now);
+} backend_t;
+
+
+// -- Linked list adapters
+
+static void list_init(uint64_t now) {
+  while (list_remove_first() != NULL);
+}
+
+static void list_insert(node_t* node, uint64_t now) {
+  list_insert_sorted(node);
+}
+
+static node_t* list_remove_expired(uint64_t now) {
+  node_t* first = list_get_first();
+  if (first != NULL && first->timer_value <= now) {
+    return list_remove_first();
+  }
+  return NULL;
+}
+
+static const backend_t backends[] = {
+  {"list", list_init, list_insert, list_remove, list_remove_expired},
+  {"wheel", wheel_init, wheel_insert, wheel_remove, wheel_remove_expired},
+};
+#define NUM_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+
+// -- Benchmark
+
+// xorshift32, so every backend sees the same sequence of operations
+static uint32_t rng_state;
+static uint32_t rng(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Returns nanoseconds per step
+static double run(const backend_t* backend, node_t* nodes, uint32_t count) {
+  rng_state = 0x12345678;
+  uint64_t now = 0;
+  backend->init(now);
+
+  for (uint32_t i = 0; i < count; i++) {
+    nodes[i].timer_value = now + 1 + rng() % MAX_DELAY;
+    backend->insert(&nodes[i], now);
+  }
+
+  uint64_t expirations = 0;
+  double start = seconds();
+  for (uint32_t step = 0; step < STEPS; step++) {
+    now += rng() % MAX_TIME_STEP;
+
+    node_t* node = NULL;
+    while ((node = backend->remove_expired(now)) != NULL) {
+      if (node->timer_value > now) {
+        printf("ERROR: %s expired a timer early\n", backend->name);
+        exit(1);
+      }
+      expirations++;
+      node->timer_value = now + 1 + rng() % MAX_DELAY;
+      backend->insert(node, now);
+    }
+
+    node = &nodes[rng() % count];
+    backend->remove(node);
+    node->timer_value = now + 1 + rng() % MAX_DELAY;
+    backend->insert(node, now);
+  }
+  double elapsed = seconds() - start;
+
+  // empty the backend so the nodes can be reused
+  for (uint32_t i = 0; i < count; i++) {
+    backend->remove(&nodes[i]);
+  }
+
+  // keep the compiler from discarding the expiration loop
+  if (expirations == UINT64_MAX) {
+    printf("\n");
+  }
+  return elapsed * 1e9 / STEPS;
+}
+
+int main(void) {
+  static const uint32_t counts[] = {4, 16, 64, 256, 1024, 4096};
+  uint32_t max_count = counts[sizeof(counts) / sizeof(counts[0]) - 1];
+  node_t* nodes = calloc(max_count, sizeof(node_t));
+
+  printf("ns per step (expire + cancel + start), %d steps\n\n", STEPS);
+  printf("%8s", "timers");
+  for (uint32_t b = 0; b < NUM_BACKENDS; b++) {
+    printf("%10s", backends[b].name);
+  }
+  printf("%10s\n", "speedup");
+
+  for (uint32_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+    double results[NUM_BACKENDS];
+    printf("%8u", counts[c]);
+    for (uint32_t b = 0; b < NUM_BACKENDS; b++) {
+      results[b] = run(&backends[b], nodes, counts[c]);
+      printf("%10.1f", results[b]);
+    }
+    printf("%9.1fx\n", results[0] / results[NUM_BACKENDS - 1]);
+  }
+
+  free(nodes);
+  return 0;
+}
@@ -20,6 +20,7 @@
 
 #include "microbit_v2.h"
 #include "virtual_timer.h"
+#include "virtual_timer_pin.h"
 
 void led1_toggle() {
     nrf_gpio_pin_toggle(LED_ROW1);
@@ -29,10 +30,6 @@ void led2_toggle() {
     nrf_gpio_pin_toggle(LED_ROW2);
 }
 
-void led3_toggle() {
-    nrf_gpio_pin_toggle(LED_ROW3);
-}
-
 int main(void) {
   printf("Board initialized!\n");
 
@@ -46,17 +43,26 @@ int main(void) {
   nrf_gpio_pin_clear(LED_ROW2);
   nrf_gpio_pin_clear(LED_ROW3);
 
+  // Initialize power management, used to sleep between timer events
+  ret_code_t error_code = nrf_pwr_mgmt_init();
+  APP_ERROR_CHECK(error_code);
+
   // Initialize your timer library
   virtual_timer_init();
   nrf_delay_ms(3000);
 
   // Setup some timers and see what happens
-  //virtual_timer_start_repeated(1000000, led1_toggle);
-  //virtual_timer_start_repeated(2000000, led2_toggle);
+  virtual_timer_start_repeated(1000000, led1_toggle);
+  virtual_timer_start_repeated(2000000, led2_toggle);
+
+  // This one toggles in hardware and never wakes the CPU
+  virtual_timer_pin_toggle_repeated(500000, LED_ROW3);
+  virtual_timer_pin_usage_print();
 
-  // loop forever
+  // loop forever, sleeping until the next interrupt
   while (1) {
-    nrf_delay_ms(1000);
+    virtual_timer_run_callbacks();
+    nrf_pwr_mgmt_run();
   }
 }
 
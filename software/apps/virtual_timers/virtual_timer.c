@@ -3,77 +3,922 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <stdlib.h>
 
 #include "nrf.h"
 
+#include "microbit_rtc.h"
 #include "virtual_timer.h"
 #include "virtual_timer_linked_list.h"
+#include "virtual_timer_pool.h"
+#include "virtual_timer_stats.h"
+#include "virtual_timer_wheel.h"
+
+#if VIRTUAL_TIMER_COMPARE_CHANNELS < 1 || VIRTUAL_TIMER_COMPARE_CHANNELS > 4
+#error "VIRTUAL_TIMER_COMPARE_CHANNELS must be between 1 and 4"
+#endif
+
+// Compare channel that fires when the counter wraps to 0
+#define OVERFLOW_CHANNEL 4
+
+// Compare channel used to capture the counter value
+#define CAPTURE_CHANNEL 5
+
+#if VIRTUAL_TIMER_CLOCK == VIRTUAL_TIMER_CLOCK_TIMER
+
+// Upper 32 bits of the 64-bit time. Incremented each time the counter wraps
+static volatile uint32_t epoch = 0;
+
+#elif VIRTUAL_TIMER_CLOCK == VIRTUAL_TIMER_CLOCK_RTC
+
+#if VIRTUAL_TIMER_PRECISE_THRESHOLD_US < 200
+#error "VIRTUAL_TIMER_PRECISE_THRESHOLD_US must be at least 200"
+#endif
+
+// RTC compare values must be a few ticks ahead of the counter to be sure to
+//  fire
+#define RTC_MIN_TICKS 3
+
+// TIMER4 is started by the RTC1 CC[1] compare through this PPI channel, so
+//  that it starts exactly on a tick without the CPU waiting for one
+#define PRECISE_PPI_CHANNEL 19
+#define PRECISE_START_CHANNEL 1
+
+// A compare two ticks ahead of the counter is the earliest that surely fires
+#define PRECISE_START_TICKS 2
+
+// TIMER4 is restarted on an RTC tick this often, so that drift between the
+//  two oscillators stays small during long runs of close deadlines
+#define PRECISE_RESYNC_US 1000000
+
+// Upper bits of the RTC tick count. Incremented each time the 24-bit counter
+//  wraps, about every 512 seconds
+static volatile uint32_t rtc_epoch = 0;
+
+// Whether TIMER4 is running or waiting for its start tick, and the time of
+//  that tick, when it starts counting from 0
+static bool precise_active = false;
+static uint64_t precise_base = 0;
+
+// Latest time returned, so that switching between the two clocks never moves
+//  time backwards
+static uint64_t last_time = 0;
+
+#else
+#error "Unknown VIRTUAL_TIMER_CLOCK"
+#endif
+
+// Deadline loaded into each compare channel, and which channels hold one that
+//  has not fired yet
+static uint64_t armed_times[VIRTUAL_TIMER_COMPARE_CHANNELS];
+static uint32_t armed_channels = 0;
+
+// Number of timer interrupts avoided by coalescing timers with slack
+static volatile uint32_t coalesced_interrupts = 0;
+
+// Run time of each callback function, and of the interrupt handler itself
+static virtual_timer_runtime_t callback_runtimes[VIRTUAL_TIMER_RUNTIME_SLOTS];
+static virtual_timer_runtime_t isr_runtime = {0};
+
+// Delay from a deadline to the start of the interrupt handler it woke up
+static virtual_timer_runtime_t wakeup_latency = {0};
+
+#if VIRTUAL_TIMER_CALLBACKS != VIRTUAL_TIMER_CALLBACKS_IMMEDIATE
+
+#if (VIRTUAL_TIMER_CALLBACK_QUEUE_SIZE & (VIRTUAL_TIMER_CALLBACK_QUEUE_SIZE - 1)) != 0
+#error "VIRTUAL_TIMER_CALLBACK_QUEUE_SIZE must be a power of two"
+#endif
+
+// Ring of IDs of expired timers whose callbacks are waiting to run. The timer
+//  interrupt handler is the only writer of `callback_head` and the bottom half
+//  is the only writer of `callback_tail`, so no locking is needed.
+// One-shot timers keep their node until the callback runs, so that cancelling
+//  a timer whose callback is still queued stops the callback
+static uint32_t callback_queue[VIRTUAL_TIMER_CALLBACK_QUEUE_SIZE];
+static volatile uint32_t callback_head = 0;
+static volatile uint32_t callback_tail = 0;
+
+// Callbacks lost because the ring was full
+static volatile uint32_t dropped_callbacks = 0;
+
+#endif
+
+// -- Pending timer queue
+//
+// Thin wrappers over the selected backend. All of these must be called with
+//  interrupts disabled.
+
+#if VIRTUAL_TIMER_BACKEND == VIRTUAL_TIMER_BACKEND_WHEEL
+
+static void queue_init(uint64_t now) {
+  wheel_init(now);
+}
+
+static void queue_insert(node_t* node, uint64_t now) {
+  wheel_insert(node, now);
+}
+
+static void queue_remove(node_t* node) {
+  wheel_remove(node);
+}
+
+static uint32_t queue_next_events(uint64_t* event_times, uint32_t max_events) {
+  return wheel_next_events(event_times, max_events);
+}
+
+static node_t* queue_remove_expired(uint64_t now) {
+  return wheel_remove_expired(now);
+}
+
+static node_t* queue_find_overlapping(uint64_t from, uint64_t to, uint64_t window_start, uint64_t window_end) {
+  return wheel_find_overlapping(from, to, window_start, window_end);
+}
+
+#elif VIRTUAL_TIMER_BACKEND == VIRTUAL_TIMER_BACKEND_LIST
+
+static void queue_init(uint64_t now) {
+}
+
+static void queue_insert(node_t* node, uint64_t now) {
+  list_insert_sorted(node);
+}
+
+static void queue_remove(node_t* node) {
+  list_remove(node);
+}
+
+static uint32_t queue_next_events(uint64_t* event_times, uint32_t max_events) {
+  uint32_t count = 0;
+  for (node_t* node = list_get_first(); node != NULL && count < max_events; node = node->next) {
+    // timers that expire together only need one compare
+    if (count == 0 || event_times[count - 1] != node->timer_value) {
+      event_times[count++] = node->timer_value;
+    }
+  }
+  return count;
+}
+
+static node_t* queue_remove_expired(uint64_t now) {
+  node_t* first = list_get_first();
+  if (first != NULL && first->timer_value <= now) {
+    return list_remove_first();
+  }
+  return NULL;
+}
+
+static node_t* queue_find_overlapping(uint64_t from, uint64_t to, uint64_t window_start, uint64_t window_end) {
+  node_t* found = NULL;
+  for (node_t* node = list_get_first(); node != NULL && node->timer_value <= to; node = node->next) {
+    if (node->timer_value >= from && node->deadline <= window_end &&
+        node->deadline + node->slack >= window_start) {
+      found = node;
+    }
+  }
+  return found;
+}
+
+#else
+#error "Unknown VIRTUAL_TIMER_BACKEND"
+#endif
+
+// Read the TIMER4 counter
+static inline uint32_t timer_counter(void) {
+  // Capture the counter into a channel that is never used for compares
+  NRF_TIMER4->TASKS_CAPTURE[CAPTURE_CHANNEL] = 1;
+  return NRF_TIMER4->CC[CAPTURE_CHANNEL];
+}
+
+// Drop events that are more than <window> microseconds after <now>
+static uint32_t events_within(const uint64_t* event_times, uint32_t count, uint64_t now, uint64_t window) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (event_times[i] - now > window) {
+      return i;
+    }
+  }
+  return count;
+}
+
+// Load events into the TIMER4 compare channels. <base> is the time at which
+//  the TIMER4 counter was 0
+// Channels that already hold one of those events are left alone, so usually
+//  only the channel that just fired is written
+static void arm_compares(const uint64_t* event_times, uint32_t count, uint64_t base) {
+  // keep channels that are armed for one of the upcoming events
+  uint32_t placed = 0;
+  uint32_t keep = 0;
+  for (uint32_t channel = 0; channel < VIRTUAL_TIMER_COMPARE_CHANNELS; channel++) {
+    if ((armed_channels & (1u << channel)) == 0) {
+      continue;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      if ((placed & (1u << i)) == 0 && event_times[i] == armed_times[channel]) {
+        placed |= (1u << i);
+        keep |= (1u << channel);
+        break;
+      }
+    }
+  }
+
+  // load the remaining events into the other channels
+  uint32_t channel = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (placed & (1u << i)) {
+      continue;
+    }
+    while (keep & (1u << channel)) {
+      channel++;
+    }
+    NRF_TIMER4->CC[channel] = (uint32_t)(event_times[i] - base);
+    armed_times[channel] = event_times[i];
+    keep |= (1u << channel);
+  }
+  armed_channels = keep;
+}
+
+#if VIRTUAL_TIMER_CLOCK == VIRTUAL_TIMER_CLOCK_RTC
+
+// Start TIMER4 exactly as the RTC ticks, so that both clocks agree on the time
+// The start is done by PPI from an RTC compare a few ticks ahead, so this
+//  returns straight away. Until then TIMER4 reads 0 and the RTC gives the time
+static void precise_start(void) {
+  NRF_TIMER4->TASKS_STOP = 1;
+  NRF_TIMER4->TASKS_CLEAR = 1;
+
+  // the compare is only sure to fire if the RTC did not tick while it was
+  //  written
+  uint64_t now_ticks;
+  uint64_t start_ticks;
+  do {
+    now_ticks = rtc_read_ticks(NRF_RTC1, &rtc_epoch);
+    start_ticks = now_ticks + PRECISE_START_TICKS;
+    NRF_RTC1->CC[PRECISE_START_CHANNEL] = (uint32_t)start_ticks & 0xFFFFFF;
+  } while (rtc_read_ticks(NRF_RTC1, &rtc_epoch) != now_ticks);
+  NRF_RTC1->EVENTS_COMPARE[PRECISE_START_CHANNEL] = 0;
+  NRF_RTC1->EVTENSET = RTC_EVTENSET_COMPARE1_Msk;
+
+  precise_base = rtc_ticks_to_us(start_ticks);
+  precise_active = true;
+  armed_channels = 0;
+}
+
+// Stop TIMER4, which lets the 16 MHz clock stop
+static void precise_stop(void) {
+  if (precise_active) {
+    // the compare would start TIMER4 again when the RTC comes back around
+    NRF_RTC1->EVTENCLR = RTC_EVTENCLR_COMPARE1_Msk;
+    NRF_TIMER4->TASKS_STOP = 1;
+    precise_active = false;
+    armed_channels = 0;
+  }
+}
+
+// Wake up from the RTC at <time>, or when the RTC wraps if <time> is too far
+//  away for the 24-bit compare
+static void rtc_arm(uint64_t time) {
+  uint64_t now_ticks = rtc_read_ticks(NRF_RTC1, &rtc_epoch);
+  uint64_t ticks = rtc_us_to_ticks(time);
+  if (ticks < now_ticks + RTC_MIN_TICKS) {
+    ticks = now_ticks + RTC_MIN_TICKS;
+  }
+
+  if (ticks - now_ticks < (1u << 24)) {
+    NRF_RTC1->CC[0] = (uint32_t)ticks & 0xFFFFFF;
+    NRF_RTC1->INTENSET = RTC_INTENSET_COMPARE0_Msk;
+  } else {
+    NRF_RTC1->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+  }
+}
+
+// Program the hardware for the next pending events
+// Far away deadlines only arm the RTC, which wakes up the CPU
+//  VIRTUAL_TIMER_PRECISE_THRESHOLD_US ahead of time. Within that window TIMER4
+//  runs and its compare channels are loaded like with the TIMER clock.
+// Returns false if the next event is already due and must be handled now
+static bool schedule_next(void) {
+  uint64_t event_times[VIRTUAL_TIMER_COMPARE_CHANNELS];
+  uint32_t count = queue_next_events(event_times, VIRTUAL_TIMER_COMPARE_CHANNELS);
+  if (count == 0) {
+    precise_stop();
+    NRF_RTC1->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+    return true;
+  }
+
+  uint64_t now = virtual_timer_read_time64();
+  if ((int64_t)(event_times[0] - now) <= 1) {
+    return false;
+  }
+
+  if (event_times[0] - now > VIRTUAL_TIMER_PRECISE_THRESHOLD_US) {
+    precise_stop();
+    rtc_arm(event_times[0] - VIRTUAL_TIMER_PRECISE_THRESHOLD_US);
+    return true;
+  }
+
+  // a resync moves the start tick ahead, so it waits for a deadline that lies
+  //  beyond the new one
+  if (precise_active && timer_counter() > PRECISE_RESYNC_US &&
+      event_times[0] - now > rtc_ticks_to_us(PRECISE_START_TICKS + 1)) {
+    precise_stop();
+  }
+  if (!precise_active) {
+    precise_start();
+  }
+
+  // TIMER4 cannot catch a deadline before or on its start tick, since it
+  //  counts from 0 there and a compare of 0 would only match after it wraps.
+  //  The RTC wakes up for it a little late instead
+  if (event_times[0] <= precise_base) {
+    rtc_arm(event_times[0]);
+    return true;
+  }
+  NRF_RTC1->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+  count = events_within(event_times, count, now, VIRTUAL_TIMER_PRECISE_THRESHOLD_US);
+  arm_compares(event_times, count, precise_base);
+
+  // make sure time did not pass the first deadline while it was being written
+  return (int64_t)(event_times[0] - virtual_timer_read_time64()) > 1;
+}
+
+#else
+
+// Program the compare registers for the next pending events
+// Compares only see the low 32 bits of the time, so events more than one
+//  counter period away are left for a later overflow interrupt to arm.
+// Returns false if the next event is already due and must be handled now. A
+//  compare only fires on an exact match, so a deadline that has passed (or is
+//  about to pass while the register is written) would otherwise be missed
+static bool schedule_next(void) {
+  uint64_t event_times[VIRTUAL_TIMER_COMPARE_CHANNELS];
+  uint32_t count = queue_next_events(event_times, VIRTUAL_TIMER_COMPARE_CHANNELS);
+  if (count == 0) {
+    return true;
+  }
+
+  uint64_t now = virtual_timer_read_time64();
+  if ((int64_t)(event_times[0] - now) <= 1) {
+    return false;
+  }
+  count = events_within(event_times, count, now, UINT32_MAX);
+  arm_compares(event_times, count, 0);
+
+  // make sure time did not pass the first deadline while it was being written
+  return (int64_t)(event_times[0] - virtual_timer_read_time64()) > 1;
+}
+
+#endif
+
+// Record that a function ran for <elapsed> microseconds
+static void runtime_add(virtual_timer_runtime_t* runtime, uint32_t elapsed) {
+  runtime->calls++;
+  runtime->total_us += elapsed;
+  if (elapsed > runtime->max_us) {
+    runtime->max_us = elapsed;
+  }
+}
+
+// Run a timer callback and account for its run time
+// Returns how long it ran in microseconds
+static uint32_t run_callback(virtual_timer_callback_t callback) {
+  uint32_t start = read_timer();
+  callback();
+  uint32_t elapsed = read_timer() - start;
+
+  // callbacks only run from one context, so the table needs no locking
+  for (uint32_t i = 0; i < VIRTUAL_TIMER_RUNTIME_SLOTS; i++) {
+    virtual_timer_runtime_t* runtime = &callback_runtimes[i];
+    if (runtime->callback == NULL) {
+      runtime->callback = callback;
+    }
+    if (runtime->callback == callback) {
+      runtime_add(runtime, elapsed);
+      break;
+    }
+  }
+  return elapsed;
+}
+
+#if VIRTUAL_TIMER_CALLBACKS != VIRTUAL_TIMER_CALLBACKS_IMMEDIATE
+
+// Hand the callback of an expired timer to the bottom half
+// Only called from the timer interrupt handler, with interrupts disabled
+static void defer_callback(node_t* node) {
+  uint32_t head = callback_head;
+  if (head - callback_tail >= VIRTUAL_TIMER_CALLBACK_QUEUE_SIZE) {
+    dropped_callbacks++;
+    if (node->period == 0) {
+      pool_free(node);
+    }
+    return;
+  }
+
+  callback_queue[head & (VIRTUAL_TIMER_CALLBACK_QUEUE_SIZE - 1)] = pool_node_id(node);
+  // the entry must be written before it is published
+  __DMB();
+  callback_head = head + 1;
+}
+
+// Run every deferred callback
+// Returns the number of callbacks run
+static uint32_t drain_callbacks(void) {
+  uint32_t count = 0;
+  uint32_t tail = callback_tail;
+  while (tail != callback_head) {
+    __DMB();
+    uint32_t timer_id = callback_queue[tail & (VIRTUAL_TIMER_CALLBACK_QUEUE_SIZE - 1)];
+    // free the entry before running the callback, which may take a while
+    tail++;
+    callback_tail = tail;
+
+    // skip timers that were cancelled after they expired
+    virtual_timer_callback_t callback = NULL;
+    uint32_t primask = critical_enter();
+    node_t* node = pool_lookup(timer_id);
+    if (node != NULL) {
+      callback = node->callback;
+      if (node->period == 0) {
+        pool_free(node);
+      }
+    }
+    critical_exit(primask);
+
+    if (callback != NULL) {
+      run_callback(callback);
+      count++;
+    }
+  }
+  return count;
+}
+
+#endif
+
+#if VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_SWI
+
+// Low-priority software interrupt that runs deferred callbacks
+void SWI1_EGU1_IRQHandler(void) {
+  // Clear interrupt event
+  NRF_EGU1->EVENTS_TRIGGERED[0] = 0;
+
+  drain_callbacks();
+}
+
+#endif
+
+// Latest time from <start> to <end> with the most low bits clear, where
+//  timers that do not know about each other are likely to land together
+static uint64_t aligned_time(uint64_t start, uint64_t end) {
+  uint64_t differing = start ^ end;
+  if (differing == 0) {
+    return start;
+  }
+
+  uint32_t bit = 63 - __builtin_clzll(differing);
+  return end & ~((1ull << bit) - 1);
+}
+
+// Pick the expiration time for a timer that may fire anywhere from <deadline>
+//  to <deadline> + <slack>, so that it shares an interrupt with a queued timer
+//  whose window overlaps:
+//  - a queued timer already expiring inside the window lends its time
+//  - a queued timer expiring up to <slack> before or after the window, that
+//    could also expire in the part both windows share, is moved there
+//  - otherwise the time is aligned within the window
+// Must be called with interrupts disabled
+static uint64_t apply_slack(uint64_t deadline, uint32_t slack, uint64_t now) {
+  uint64_t limit = deadline + slack;
+  if (slack == 0) {
+    return deadline;
+  }
+
+  node_t* other = queue_find_overlapping(deadline, limit, deadline, limit);
+  if (other != NULL) {
+    return other->timer_value;
+  }
+
+  uint64_t from = (deadline > slack) ? deadline - slack : 0;
+  other = queue_find_overlapping(from, limit + slack, deadline, limit);
+  if (other == NULL) {
+    return aligned_time(deadline, limit);
+  }
+
+  uint64_t start = (other->deadline > deadline) ? other->deadline : deadline;
+  uint64_t other_limit = other->deadline + other->slack;
+  uint64_t end = (other_limit < limit) ? other_limit : limit;
+  queue_remove(other);
+  other->timer_value = aligned_time(start, end);
+  queue_insert(other, now);
+  return other->timer_value;
+}
+
+// Timers that expire at the same time are removed from the queue one after
+//  another. Count how many interrupts slack saved for each such group: every
+//  timer that was moved off its deadline saved one, unless none of the timers
+//  in the group needed this exact time, in which case one of them owns it
+typedef struct {
+  uint64_t time;
+  uint32_t moved;
+  bool exact;
+} coalesce_group_t;
+
+static void coalesce_group_end(coalesce_group_t* group) {
+  if (group->moved != 0) {
+    coalesced_interrupts += group->moved - (group->exact ? 0 : 1);
+  }
+  group->moved = 0;
+  group->exact = false;
+}
+
+static void coalesce_group_add(coalesce_group_t* group, node_t* node, bool first) {
+  if (first || node->timer_value != group->time) {
+    coalesce_group_end(group);
+    group->time = node->timer_value;
+  }
+  if (node->deadline == node->timer_value) {
+    group->exact = true;
+  } else {
+    group->moved++;
+  }
+}
+
+// Handle every expired timer, then arm the hardware for the next one
+// Called from the interrupt handlers once their events are cleared
+static void service_timers(void) {
+  // time spent in callbacks is not counted against the handler
+  uint32_t entry_cycles = stats_cycles();
+  uint64_t entry_time = virtual_timer_read_time64();
+  uint32_t isr_start = read_timer();
+  uint32_t callback_time = 0;
+  uint32_t primask;
+
+  // Handle every expired timer, then arm the compare for the next one
+  coalesce_group_t group = {0};
+  bool first = true;
+  while (true) {
+    primask = critical_enter();
+    uint64_t now = virtual_timer_read_time64();
+    node_t* node = queue_remove_expired(now);
+
+    if (node == NULL) {
+      bool armed = schedule_next();
+      critical_exit(primask);
+      if (armed) {
+        break;
+      }
+      continue;
+    }
+    if (first && node->timer_value <= entry_time) {
+      runtime_add(&wakeup_latency, entry_time - node->timer_value);
+    }
+    uint64_t lateness = now - node->timer_value;
+    stats_record_expiry(lateness > UINT32_MAX ? UINT32_MAX : (uint32_t)lateness, pool_used());
+    coalesce_group_add(&group, node, first);
+    first = false;
+
+    // repeated timers are re-armed from their previous deadline to avoid drift
+    virtual_timer_callback_t callback = node->callback;
+    if (node->period != 0) {
+      node->deadline += node->period;
+      node->timer_value = apply_slack(node->deadline, node->slack, now);
+      queue_insert(node, now);
+    }
+#if VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_IMMEDIATE
+    else {
+      pool_free(node);
+    }
+    critical_exit(primask);
+
+    // the callback may start or cancel timers, so the node is not touched
+    //  after it runs
+    callback_time += run_callback(callback);
+#else
+    (void)callback;
+    defer_callback(node);
+    critical_exit(primask);
+#endif
+  }
+  coalesce_group_end(&group);
+
+#if VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_SWI
+  if (!first) {
+    NRF_EGU1->TASKS_TRIGGER[0] = 1;
+  }
+#endif
+
+  runtime_add(&isr_runtime, read_timer() - isr_start - callback_time);
+  stats_record_interrupt(stats_cycles() - entry_cycles);
+}
 
 // This is the interrupt handler that fires on a compare event
 void TIMER4_IRQHandler(void) {
-  // This should always be the first line of the interrupt handler!
-  // It clears the event so that it doesn't happen again
-  NRF_TIMER4->EVENTS_COMPARE[0] = 0;
+  // This should always be the first thing in the interrupt handler!
+  // It clears the events so that they don't happen again. Every channel that
+  //  fired is serviced by this one entry
+  for (uint32_t channel = 0; channel < VIRTUAL_TIMER_COMPARE_CHANNELS; channel++) {
+    if (NRF_TIMER4->EVENTS_COMPARE[channel]) {
+      NRF_TIMER4->EVENTS_COMPARE[channel] = 0;
+      armed_channels &= ~(1u << channel);
+    }
+  }
 
-  // Place your interrupt handler code here
+#if VIRTUAL_TIMER_CLOCK == VIRTUAL_TIMER_CLOCK_TIMER
+  // the counter wrapped. The epoch must change together with the event, so
+  //  that `virtual_timer_read_time64()` never sees one without the other
+  uint32_t primask = critical_enter();
+  if (NRF_TIMER4->EVENTS_COMPARE[OVERFLOW_CHANNEL]) {
+    NRF_TIMER4->EVENTS_COMPARE[OVERFLOW_CHANNEL] = 0;
+    epoch++;
+  }
+  critical_exit(primask);
+#endif
 
+  service_timers();
 }
 
-// Read the current value of the timer counter
+#if VIRTUAL_TIMER_CLOCK == VIRTUAL_TIMER_CLOCK_RTC
+
+// Fires ahead of a deadline, and when the RTC counter wraps
+void RTC1_IRQHandler(void) {
+  NRF_RTC1->EVENTS_COMPARE[0] = 0;
+
+  uint32_t primask = critical_enter();
+  if (NRF_RTC1->EVENTS_OVRFLW) {
+    NRF_RTC1->EVENTS_OVRFLW = 0;
+    rtc_epoch++;
+  }
+  critical_exit(primask);
+
+  service_timers();
+}
+
+#endif
+
+#if VIRTUAL_TIMER_CLOCK == VIRTUAL_TIMER_CLOCK_RTC
+
+// Read the current 64-bit time in microseconds
+// While TIMER4 runs it gives the exact time, otherwise the RTC gives it to
+//  within one tick
+uint64_t virtual_timer_read_time64(void) {
+  uint32_t primask = critical_enter();
+  uint64_t time;
+  uint32_t counter = precise_active ? timer_counter() : 0;
+  if (counter != 0) {
+    time = precise_base + counter;
+  } else {
+    // TIMER4 is stopped, or has not reached its start tick yet
+    time = rtc_ticks_to_us(rtc_read_ticks(NRF_RTC1, &rtc_epoch));
+  }
+
+  if (time < last_time) {
+    time = last_time;
+  }
+  last_time = time;
+  critical_exit(primask);
+
+  return time;
+}
+
+// The counter is only running close to deadlines, so use the low bits of the
+//  64-bit time instead
 uint32_t read_timer(void) {
+  return (uint32_t)virtual_timer_read_time64();
+}
 
-  // Should return the value of the internal counter for TIMER4
-  return 0;
+// Start the low frequency clock and RTC1, which keep time, and set up TIMER4
+//  to count microseconds once it is started close to a deadline
+void virtual_timer_init(void) {
+  rtc_setup(NRF_RTC1);
+  NRF_RTC1->INTENSET = RTC_INTENSET_OVRFLW_Msk;
+  NVIC_EnableIRQ(RTC1_IRQn);
+
+  // the CC[1] compare starts TIMER4, once precise_start() routes it
+  NRF_RTC1->EVTENCLR = RTC_EVTENCLR_COMPARE1_Msk;
+  NRF_PPI->CH[PRECISE_PPI_CHANNEL].EEP = (uint32_t)&NRF_RTC1->EVENTS_COMPARE[PRECISE_START_CHANNEL];
+  NRF_PPI->CH[PRECISE_PPI_CHANNEL].TEP = (uint32_t)&NRF_TIMER4->TASKS_START;
+  NRF_PPI->CHENSET = 1u << PRECISE_PPI_CHANNEL;
+
+  NRF_TIMER4->MODE = TIMER_MODE_MODE_Timer;
+  NRF_TIMER4->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  NRF_TIMER4->PRESCALER = 4; // 16 MHz / 2^4 = 1 MHz
+  NRF_TIMER4->INTENSET = ((1u << VIRTUAL_TIMER_COMPARE_CHANNELS) - 1) << TIMER_INTENSET_COMPARE0_Pos;
+  NVIC_EnableIRQ(TIMER4_IRQn);
+
+  rtc_epoch = 0;
+  last_time = 0;
+  precise_active = false;
+  armed_channels = 0;
+
+#if VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_SWI
+  // deferred callbacks run below the timer and other peripheral interrupts
+  NRF_EGU1->INTENSET = 0x1;
+  NVIC_SetPriority(SWI1_EGU1_IRQn, 7);
+  NVIC_EnableIRQ(SWI1_EGU1_IRQn);
+#endif
+
+  NRF_RTC1->TASKS_START = 1;
+
+  uint32_t primask = critical_enter();
+  pool_init();
+  stats_init();
+  queue_init(virtual_timer_read_time64());
+  critical_exit(primask);
+}
+
+#else
+
+// Read the current 64-bit time in microseconds
+uint64_t virtual_timer_read_time64(void) {
+  uint32_t primask = critical_enter();
+  uint32_t counter = timer_counter();
+  uint32_t high = epoch;
+
+  // the counter wrapped, but the interrupt handler has not counted it yet. The
+  //  check on the counter value rules out a wrap right after it was read
+  if (NRF_TIMER4->EVENTS_COMPARE[OVERFLOW_CHANNEL] && counter < 0x80000000) {
+    high++;
+  }
+  critical_exit(primask);
+
+  return ((uint64_t)high << 32) | counter;
 }
 
-// Initialize TIMER4 as a free running timer
-// 1) Set to be a 32 bit timer
-// 2) Set to count at 1MHz
-// 3) Enable the timer peripheral interrupt (look carefully at the INTENSET register!)
-//    Skip this for the first part of the lab.
-// 4) Clear the timer
-// 5) Start the timer
+// Read the current value of the timer counter
+uint32_t read_timer(void) {
+  return timer_counter();
+}
+
+// Initialize TIMER4 as a free running 32-bit timer counting at 1MHz, with
+//  an interrupt on each compare channel used for deadlines and on the channel
+//  that counts overflows
 void virtual_timer_init(void) {
-  // Place your timer initialization code here
+  NRF_TIMER4->MODE = TIMER_MODE_MODE_Timer;
+  NRF_TIMER4->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  NRF_TIMER4->PRESCALER = 4; // 16 MHz / 2^4 = 1 MHz
+
+  epoch = 0;
+  armed_channels = 0;
+  NRF_TIMER4->CC[OVERFLOW_CHANNEL] = 0;
+  NRF_TIMER4->INTENSET = (((1u << VIRTUAL_TIMER_COMPARE_CHANNELS) - 1) << TIMER_INTENSET_COMPARE0_Pos) |
+                         (1u << (TIMER_INTENSET_COMPARE0_Pos + OVERFLOW_CHANNEL));
+  NVIC_EnableIRQ(TIMER4_IRQn);
+
+#if VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_SWI
+  // deferred callbacks run below the timer and other peripheral interrupts
+  NRF_EGU1->INTENSET = 0x1;
+  NVIC_SetPriority(SWI1_EGU1_IRQn, 7);
+  NVIC_EnableIRQ(SWI1_EGU1_IRQn);
+#endif
+
+  NRF_TIMER4->TASKS_CLEAR = 1;
+  NRF_TIMER4->TASKS_START = 1;
+
+  uint32_t primask = critical_enter();
+  pool_init();
+  stats_init();
+  queue_init(virtual_timer_read_time64());
+  critical_exit(primask);
 }
 
+#endif
+
 // Start a timer. This function is called for both one-shot and repeated timers
-// To start a timer:
-// 1) Create a linked list node (This requires `malloc()`. Don't forget to free later)
-// 2) Setup the linked list node with the correct information
-//      - You will need to modify the `node_t` struct in "virtual_timer_linked_list.h"!
-// 3) Place the node in the linked list
-// 4) Setup the compare register so that the timer fires at the right time
-// 5) Return a timer ID
-//
-// Your implementation will also have to take special precautions to make sure that
-//  - You do not miss any timers
-//  - You do not cause consistency issues in the linked list (hint: you may need the `__disable_irq()` and `__enable_irq()` functions).
-//
-// Follow the lab manual and start with simple cases first, building complexity and
-// testing it over time.
-static uint32_t timer_start(uint32_t microseconds, virtual_timer_callback_t cb, bool repeated) {
+// The node comes from the pool and is freed when a one-shot timer fires or when
+//  the timer is cancelled. Safe to call from interrupt handlers and callbacks.
+// Returns 0 if the pool is exhausted
+static uint32_t timer_start(uint32_t microseconds, uint32_t slack, virtual_timer_callback_t cb, bool repeated) {
+  uint32_t primask = critical_enter();
+  node_t* node = pool_alloc();
+  if (node == NULL) {
+    critical_exit(primask);
+    return 0;
+  }
+  node->callback = cb;
+  node->period = repeated ? microseconds : 0;
+  node->slack = slack;
+  node->prev = NULL;
 
-  // Return a unique timer ID. (hint: What is guaranteed unique about the timer you have created?)
-  return 0;
+  uint64_t now = virtual_timer_read_time64();
+  node->deadline = now + microseconds;
+  node->timer_value = apply_slack(node->deadline, slack, now);
+  queue_insert(node, now);
+
+  // if the deadline already passed, let the interrupt handler deal with it
+  if (!schedule_next()) {
+    NVIC_SetPendingIRQ(TIMER4_IRQn);
+  }
+  uint32_t timer_id = pool_node_id(node);
+  critical_exit(primask);
+
+  return timer_id;
 }
 
 // You do not need to modify this function
 // Instead, implement timer_start
 uint32_t virtual_timer_start(uint32_t microseconds, virtual_timer_callback_t cb) {
-  return timer_start(microseconds, cb, false);
+  return timer_start(microseconds, 0, cb, false);
 }
 
 // You do not need to modify this function
 // Instead, implement timer_start
 uint32_t virtual_timer_start_repeated(uint32_t microseconds, virtual_timer_callback_t cb) {
-  return timer_start(microseconds, cb, true);
+  return timer_start(microseconds, 0, cb, true);
 }
 
-// Remove a timer by ID.
-// Make sure you don't cause linked list consistency issues!
-// Do not forget to free removed timers.
-void virtual_timer_cancel(uint32_t timer_id) {
+uint32_t virtual_timer_start_with_slack(uint32_t microseconds, uint32_t slack_microseconds, virtual_timer_callback_t cb) {
+  return timer_start(microseconds, slack_microseconds, cb, false);
 }
 
+uint32_t virtual_timer_start_repeated_with_slack(uint32_t microseconds, uint32_t slack_microseconds, virtual_timer_callback_t cb) {
+  return timer_start(microseconds, slack_microseconds, cb, true);
+}
+
+uint32_t virtual_timer_coalesced_interrupts(void) {
+  return coalesced_interrupts;
+}
+
+uint32_t virtual_timer_run_callbacks(void) {
+#if VIRTUAL_TIMER_CALLBACKS == VIRTUAL_TIMER_CALLBACKS_MAIN
+  return drain_callbacks();
+#else
+  return 0;
+#endif
+}
+
+uint32_t virtual_timer_dropped_callbacks(void) {
+#if VIRTUAL_TIMER_CALLBACKS != VIRTUAL_TIMER_CALLBACKS_IMMEDIATE
+  return dropped_callbacks;
+#else
+  return 0;
+#endif
+}
+
+bool virtual_timer_get_runtime(virtual_timer_callback_t cb, virtual_timer_runtime_t* runtime) {
+  for (uint32_t i = 0; i < VIRTUAL_TIMER_RUNTIME_SLOTS; i++) {
+    if (callback_runtimes[i].callback == cb) {
+      *runtime = callback_runtimes[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+void virtual_timer_get_isr_runtime(virtual_timer_runtime_t* runtime) {
+  *runtime = isr_runtime;
+}
+
+void virtual_timer_get_wakeup_latency(virtual_timer_runtime_t* latency) {
+  *latency = wakeup_latency;
+}
+
+void virtual_timer_runtime_print(void) {
+  printf("Timer interrupt: %lu entries, %lu us total, %lu us max\n",
+      isr_runtime.calls, isr_runtime.total_us, isr_runtime.max_us);
+  printf("Wake-up latency: %lu wake-ups, %lu us total, %lu us max\n",
+      wakeup_latency.calls, wakeup_latency.total_us, wakeup_latency.max_us);
+  for (uint32_t i = 0; i < VIRTUAL_TIMER_RUNTIME_SLOTS; i++) {
+    virtual_timer_runtime_t* runtime = &callback_runtimes[i];
+    if (runtime->callback == NULL) {
+      break;
+    }
+    printf("Callback %p: %lu calls, %lu us total, %lu us max\n", (void*)runtime->callback,
+        runtime->calls, runtime->total_us, runtime->max_us);
+  }
+}
+
+bool virtual_timer_get_stats(virtual_timer_stats_t* stats) {
+#if VIRTUAL_TIMER_STATS
+  uint32_t primask = critical_enter();
+  stats_copy(stats);
+  critical_exit(primask);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void virtual_timer_stats_reset(void) {
+  uint32_t primask = critical_enter();
+  stats_init();
+  critical_exit(primask);
+}
+
+void virtual_timer_stats_dump(void) {
+#if VIRTUAL_TIMER_STATS
+  virtual_timer_stats_t stats;
+  virtual_timer_get_stats(&stats);
+  stats_print(&stats);
+#else
+  printf("Virtual timer stats are disabled. Set VIRTUAL_TIMER_STATS to 1\n");
+#endif
+}
+
+// Remove a timer by ID. IDs of timers that already fired or were cancelled are
+//  ignored.
+// The compare register is left alone. If it was armed for this timer, the
+//  interrupt handler finds nothing expired and re-arms for the next event.
+void virtual_timer_cancel(uint32_t timer_id) {
+  uint32_t primask = critical_enter();
+  node_t* node = pool_lookup(timer_id);
+  if (node != NULL) {
+    queue_remove(node);
+    pool_free(node);
+  }
+  critical_exit(primask);
+}
@@ -1,24 +1,193 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include "nrf.h"
 
+// Data structures that can hold pending timers
+//  - LIST:  sorted linked list, O(n) start and cancel
+//  - WHEEL: hierarchical timing wheel, O(1) start and cancel
+#define VIRTUAL_TIMER_BACKEND_LIST  0
+#define VIRTUAL_TIMER_BACKEND_WHEEL 1
+
+// Select the data structure used for pending timers
+#ifndef VIRTUAL_TIMER_BACKEND
+#define VIRTUAL_TIMER_BACKEND VIRTUAL_TIMER_BACKEND_WHEEL
+#endif
+
+// Hardware that keeps time
+//  - TIMER: TIMER4 counts microseconds all the time. Exact, but the 16 MHz
+//           clock must run even while the CPU sleeps
+//  - RTC:   RTC1 counts the 32.768 kHz low frequency clock and wakes the CPU
+//           shortly before each deadline. TIMER4 only runs for the last
+//           VIRTUAL_TIMER_PRECISE_THRESHOLD_US before a deadline, so timers
+//           still fire on the exact microsecond
+#define VIRTUAL_TIMER_CLOCK_TIMER 0
+#define VIRTUAL_TIMER_CLOCK_RTC   1
+
+#ifndef VIRTUAL_TIMER_CLOCK
+#define VIRTUAL_TIMER_CLOCK VIRTUAL_TIMER_CLOCK_TIMER
+#endif
+
+// With the RTC clock, how long before a deadline TIMER4 takes over. It must
+//  cover the RTC resolution (about 31 us) and the time to wake up and start
+//  TIMER4. Larger values keep the 16 MHz clock on for longer
+#ifndef VIRTUAL_TIMER_PRECISE_THRESHOLD_US
+#define VIRTUAL_TIMER_PRECISE_THRESHOLD_US 1000
+#endif
+
+// Number of TIMER4 compare channels armed with upcoming deadlines, from 1 to 4.
+//  With more than one, deadlines close together are loaded into the hardware
+//  ahead of time, so none are missed while the interrupt handler is busy and
+//  the handler services all of them in a single entry. CC[4] counts counter
+//  overflows and CC[5] is reserved for reading the counter.
+#ifndef VIRTUAL_TIMER_COMPARE_CHANNELS
+#define VIRTUAL_TIMER_COMPARE_CHANNELS 4
+#endif
+
+// Where timer callbacks run
+//  - IMMEDIATE: inside the TIMER4 interrupt handler
+//  - SWI:       in the low-priority SWI1_EGU1 software interrupt
+//  - MAIN:      in the main loop, which must call virtual_timer_run_callbacks()
+// With SWI and MAIN the timer interrupt only queues expired callbacks, so a
+//  slow callback cannot delay other timers or interrupts
+#define VIRTUAL_TIMER_CALLBACKS_IMMEDIATE 0
+#define VIRTUAL_TIMER_CALLBACKS_SWI       1
+#define VIRTUAL_TIMER_CALLBACKS_MAIN      2
+
+#ifndef VIRTUAL_TIMER_CALLBACKS
+#define VIRTUAL_TIMER_CALLBACKS VIRTUAL_TIMER_CALLBACKS_IMMEDIATE
+#endif
+
+// Number of expired callbacks that can wait for the SWI or main loop. Must be
+//  a power of two
+#ifndef VIRTUAL_TIMER_CALLBACK_QUEUE_SIZE
+#define VIRTUAL_TIMER_CALLBACK_QUEUE_SIZE 32
+#endif
+
+// Number of distinct callback functions whose run time is tracked
+#ifndef VIRTUAL_TIMER_RUNTIME_SLOTS
+#define VIRTUAL_TIMER_RUNTIME_SLOTS 8
+#endif
+
+// Collect a histogram of how late timers expire, along with interrupt handler
+//  and queue statistics. See virtual_timer_stats_dump()
+#ifndef VIRTUAL_TIMER_STATS
+#define VIRTUAL_TIMER_STATS 0
+#endif
+
+// Number of log2 buckets in the lateness histogram. Bucket 0 counts timers
+//  that were on time, bucket i counts lateness from 2^(i-1) to 2^i - 1 us, and
+//  the last bucket also counts everything later
+#ifndef VIRTUAL_TIMER_STATS_BUCKETS
+#define VIRTUAL_TIMER_STATS_BUCKETS 16
+#endif
+
 // Type for the function pointer to call when the timer expires
 typedef void (*virtual_timer_callback_t)(void);
 
+// Run time accounting, in microseconds
+typedef struct {
+  virtual_timer_callback_t callback;
+  uint32_t calls;
+  uint32_t total_us;
+  uint32_t max_us;
+} virtual_timer_runtime_t;
+
+// Expiry statistics, collected when VIRTUAL_TIMER_STATS is 1
+typedef struct {
+  // expired timers and how late they ran in microseconds, against the time
+  //  the timer was scheduled for
+  uint32_t expiries;
+  uint32_t lateness_histogram[VIRTUAL_TIMER_STATS_BUCKETS];
+  uint32_t max_lateness_us;
+
+  // running timers at each expiry, including the one expiring
+  uint32_t total_queue_length;
+  uint32_t max_queue_length;
+
+  // timer interrupt handler duration in CPU cycles, including callbacks
+  uint32_t interrupts;
+  uint64_t total_isr_cycles;
+  uint32_t max_isr_cycles;
+} virtual_timer_stats_t;
+
 // Read the current value of the hardware timer counter
-// Returns the counter value
+// Returns the counter value, which wraps about every 71 minutes. With the RTC
+//  clock this is the low 32 bits of virtual_timer_read_time64()
 uint32_t read_timer(void);
 
+// Read the current time in microseconds, extended to 64 bits so that it never
+//  wraps. Timers are scheduled on this time base
+uint64_t virtual_timer_read_time64(void);
+
 // Initialize the timer peripheral
 void virtual_timer_init(void);
 
+// Maximum number of timers that can be running at once
+#ifndef VIRTUAL_TIMER_POOL_SIZE
+#define VIRTUAL_TIMER_POOL_SIZE 64
+#endif
+
 // Start a one-shot timer that calls <cb> <microseconds> in the future
-// Returns a unique timer_id
+// Returns a unique timer_id, or 0 if too many timers are running
 uint32_t virtual_timer_start(uint32_t microseconds, virtual_timer_callback_t cb);
 
 // Start timer that repeatedly calls <cb> <microseconds> in the future
-// Returns a unique timer_id
+// Returns a unique timer_id, or 0 if too many timers are running
 uint32_t virtual_timer_start_repeated(uint32_t microseconds, virtual_timer_callback_t cb);
 
+// Start a one-shot timer that calls <cb> between <microseconds> and
+//  <microseconds> + <slack_microseconds> in the future. Timers whose windows
+//  overlap are grouped onto a single interrupt
+// Returns a unique timer_id, or 0 if too many timers are running
+uint32_t virtual_timer_start_with_slack(uint32_t microseconds, uint32_t slack_microseconds, virtual_timer_callback_t cb);
+
+// Start timer that repeatedly calls <cb> every <microseconds>, allowing each
+//  call to be up to <slack_microseconds> late. Lateness does not accumulate
+// Returns a unique timer_id, or 0 if too many timers are running
+uint32_t virtual_timer_start_repeated_with_slack(uint32_t microseconds, uint32_t slack_microseconds, virtual_timer_callback_t cb);
+
+// Returns the number of timer interrupts that were avoided by grouping timers
+//  with slack
+uint32_t virtual_timer_coalesced_interrupts(void);
+
+// Run callbacks that have expired. Call this from the main loop when
+//  VIRTUAL_TIMER_CALLBACKS is MAIN, otherwise it does nothing
+// Returns the number of callbacks run
+uint32_t virtual_timer_run_callbacks(void);
+
+// Returns the number of expired callbacks that were lost because the queue
+//  for SWI or MAIN callbacks was full
+uint32_t virtual_timer_dropped_callbacks(void);
+
+// Get the run time of callback function <cb>
+// Returns false if <cb> has never run
+bool virtual_timer_get_runtime(virtual_timer_callback_t cb, virtual_timer_runtime_t* runtime);
+
+// Get the run time of the timer interrupt handler, not counting callbacks
+void virtual_timer_get_isr_runtime(virtual_timer_runtime_t* runtime);
+
+// Get how late the timer interrupt handler started after the deadline that
+//  woke it up. This includes waking the CPU from sleep
+void virtual_timer_get_wakeup_latency(virtual_timer_runtime_t* latency);
+
+// Print run times for the interrupt handler and every callback
+void virtual_timer_runtime_print(void);
+
+// Get a copy of the expiry statistics
+// Returns false if VIRTUAL_TIMER_STATS is 0
+bool virtual_timer_get_stats(virtual_timer_stats_t* stats);
+
+// Clear the expiry statistics
+void virtual_timer_stats_reset(void);
+
+// Print the lateness histogram and other expiry statistics
+void virtual_timer_stats_dump(void);
+
 // Takes a timer_id and cancels that timer such that it stops firing
+// Cancelling a timer that already fired or was already cancelled does nothing.
+//  With SWI or MAIN callbacks, an expired callback that is still queued does
+//  not run, but one that is already being started may still run if the cancel
+//  comes from a higher priority interrupt
 void virtual_timer_cancel(uint32_t timer_id);
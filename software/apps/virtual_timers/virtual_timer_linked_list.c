@@ -1,6 +1,9 @@
 // Linked list implementation for virtual timers
 //
-// The list is singly linked and always sorted by the `timer_value` field
+// The list is always sorted by the `timer_value` field. It is doubly linked
+//  when VIRTUAL_TIMER_LIST_DOUBLY_LINKED is set, which lets a node be removed
+//  without searching for it. Otherwise it is singly linked and `prev` is
+//  unused.
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -16,6 +19,18 @@
 static node_t* linked_list = NULL;
 
 
+// -- Internal functions
+
+// point the node after <node> back at it
+static inline void link_back(node_t* node) {
+#if VIRTUAL_TIMER_LIST_DOUBLY_LINKED
+    if (node->next != NULL) {
+        node->next->prev = node;
+    }
+#endif
+}
+
+
 // -- External functions
 
 // insert item into list sorted by `timer_value`
@@ -29,6 +44,7 @@ void list_insert_sorted(node_t* node) {
     }
 
     // node was valid, let's insert it
+    node->prev = NULL;
     if (linked_list == NULL) {
         // list was previously empty
         node->next = NULL;
@@ -39,6 +55,7 @@ void list_insert_sorted(node_t* node) {
             // node is new head
             node->next = linked_list;
             linked_list = node;
+            link_back(node);
         } else {
             // node is somewhere after the head
             node_t* prev_node = linked_list;
@@ -52,6 +69,10 @@ void list_insert_sorted(node_t* node) {
             // insert node
             prev_node->next = node;
             node->next = curr_node;
+#if VIRTUAL_TIMER_LIST_DOUBLY_LINKED
+            node->prev = prev_node;
+#endif
+            link_back(node);
         }
     }
 }
@@ -67,6 +88,12 @@ node_t* list_remove_first() {
     node_t* head = linked_list;
     if (head != NULL) {
         linked_list = head->next;
+#if VIRTUAL_TIMER_LIST_DOUBLY_LINKED
+        if (linked_list != NULL) {
+            linked_list->prev = NULL;
+        }
+        head->next = NULL;
+#endif
     }
     return head;
 }
@@ -80,6 +107,24 @@ void list_remove(node_t* node) {
         APP_ERROR_CHECK(NRF_ERROR_NULL);
     }
 
+#if VIRTUAL_TIMER_LIST_DOUBLY_LINKED
+    // only the head has no previous node, anything else is not in the list
+    if (node->prev == NULL && node != linked_list) {
+        return;
+    }
+
+    // unlink the node from its neighbors
+    if (node->prev != NULL) {
+        node->prev->next = node->next;
+    } else {
+        linked_list = node->next;
+    }
+    if (node->next != NULL) {
+        node->next->prev = node->prev;
+    }
+    node->next = NULL;
+    node->prev = NULL;
+#else
     // check for empty list
     if (linked_list != NULL) {
 
@@ -103,6 +148,7 @@ void list_remove(node_t* node) {
             }
         }
     }
+#endif
 }
 
 // print contents of list
@@ -113,12 +159,12 @@ void list_print() {
     } else {
 
         // print first node
-        printf("[ (%lu)", linked_list->timer_value);
+        printf("[ (%llu)", (unsigned long long)linked_list->timer_value);
 
         // print the other nodes
         node_t* curr_node = linked_list->next;
         while (curr_node != NULL) {
-            printf(" -> (%lu)", curr_node->timer_value);
+            printf(" -> (%llu)", (unsigned long long)curr_node->timer_value);
             curr_node = curr_node->next;
         }
         printf(" ]\n");
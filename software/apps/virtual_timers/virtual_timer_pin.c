@@ -0,0 +1,257 @@
+// Hardware pin timers
+//
+// Each hardware pin uses one GPIOTE channel and one PPI channel, both found
+//  by looking for channels that nobody has configured yet, so other code that
+//  sets up its channels first is left alone. IDs 1 to 8 are GPIOTE channels
+//  and higher IDs are software slots.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "nrf.h"
+#include "nrf_gpio.h"
+
+#include "virtual_timer.h"
+#include "virtual_timer_pin.h"
+
+#define TIMER_COUNT 5
+#define GPIOTE_CHANNELS 8
+#define PPI_CHANNELS 20
+
+// TIMER peripherals by number
+static NRF_TIMER_Type* const timers[TIMER_COUNT] = {
+  NRF_TIMER0, NRF_TIMER1, NRF_TIMER2, NRF_TIMER3, NRF_TIMER4,
+};
+
+// A hardware pin timer, indexed by GPIOTE channel
+typedef struct {
+  bool active;
+  uint32_t pin;
+  uint8_t timer;
+  uint8_t ppi_channel;
+} hardware_pin_t;
+
+// A pin toggled by a repeated virtual timer
+typedef struct {
+  bool active;
+  uint32_t pin;
+  uint32_t timer_id;
+} software_pin_t;
+
+static hardware_pin_t hardware_pins[GPIOTE_CHANNELS];
+static software_pin_t software_pins[VIRTUAL_TIMER_PIN_SOFTWARE_SLOTS];
+
+// Period of each TIMER, and how many pins use it
+static uint32_t timer_periods[TIMER_COUNT];
+static uint32_t timer_users[TIMER_COUNT];
+
+
+// -- Software fallback
+//
+// Timer callbacks take no arguments, so each software slot has its own
+
+static void software_toggle(uint32_t slot) {
+  nrf_gpio_pin_toggle(software_pins[slot].pin);
+}
+
+static void software_toggle_0(void) { software_toggle(0); }
+static void software_toggle_1(void) { software_toggle(1); }
+static void software_toggle_2(void) { software_toggle(2); }
+static void software_toggle_3(void) { software_toggle(3); }
+
+#if VIRTUAL_TIMER_PIN_SOFTWARE_SLOTS > 4
+#error "Add more software_toggle_ callbacks for VIRTUAL_TIMER_PIN_SOFTWARE_SLOTS"
+#endif
+
+static const virtual_timer_callback_t software_callbacks[4] = {
+  software_toggle_0, software_toggle_1, software_toggle_2, software_toggle_3,
+};
+
+static uint32_t start_software(uint32_t microseconds, uint32_t pin) {
+  for (uint32_t slot = 0; slot < VIRTUAL_TIMER_PIN_SOFTWARE_SLOTS; slot++) {
+    if (!software_pins[slot].active) {
+      software_pins[slot].pin = pin;
+      software_pins[slot].timer_id = virtual_timer_start_repeated(microseconds, software_callbacks[slot]);
+      if (software_pins[slot].timer_id == 0) {
+        return 0;
+      }
+      software_pins[slot].active = true;
+      return GPIOTE_CHANNELS + slot + 1;
+    }
+  }
+  return 0;
+}
+
+
+// -- Hardware resources
+
+// A GPIOTE channel is free if it is disabled and not ours
+static int32_t find_gpiote_channel(void) {
+  for (int32_t channel = 0; channel < GPIOTE_CHANNELS; channel++) {
+    uint32_t mode = (NRF_GPIOTE->CONFIG[channel] & GPIOTE_CONFIG_MODE_Msk) >> GPIOTE_CONFIG_MODE_Pos;
+    if (!hardware_pins[channel].active && mode == GPIOTE_CONFIG_MODE_Disabled) {
+      return channel;
+    }
+  }
+  return -1;
+}
+
+// A PPI channel is free if it is disabled and has no endpoints
+static int32_t find_ppi_channel(void) {
+  for (int32_t channel = 0; channel < PPI_CHANNELS; channel++) {
+    if ((NRF_PPI->CHEN & (1u << channel)) == 0 &&
+        NRF_PPI->CH[channel].EEP == 0 && NRF_PPI->CH[channel].TEP == 0) {
+      return channel;
+    }
+  }
+  return -1;
+}
+
+// Use a TIMER already running at <microseconds>, or an idle one
+static int32_t find_timer(uint32_t microseconds) {
+  int32_t idle = -1;
+  for (int32_t timer = 0; timer < TIMER_COUNT; timer++) {
+    if ((VIRTUAL_TIMER_PIN_TIMERS & (1u << timer)) == 0) {
+      continue;
+    }
+    if (timer_users[timer] != 0 && timer_periods[timer] == microseconds) {
+      return timer;
+    }
+    if (timer_users[timer] == 0 && idle < 0) {
+      idle = timer;
+    }
+  }
+  return idle;
+}
+
+// Run a TIMER at 1 MHz that clears itself every <microseconds>
+static void timer_configure(uint32_t timer, uint32_t microseconds) {
+  NRF_TIMER_Type* t = timers[timer];
+  t->TASKS_STOP = 1;
+  t->MODE = TIMER_MODE_MODE_Timer;
+  t->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  t->PRESCALER = 4; // 16 MHz / 2^4 = 1 MHz
+  t->CC[0] = microseconds;
+  t->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+  t->TASKS_CLEAR = 1;
+  t->TASKS_START = 1;
+}
+
+
+// -- External functions
+
+uint32_t virtual_timer_pin_toggle_repeated(uint32_t microseconds, uint32_t pin) {
+  if (microseconds == 0) {
+    return 0;
+  }
+
+  int32_t timer = find_timer(microseconds);
+  int32_t gpiote_channel = find_gpiote_channel();
+  int32_t ppi_channel = find_ppi_channel();
+  if (timer < 0 || gpiote_channel < 0 || ppi_channel < 0) {
+    return start_software(microseconds, pin);
+  }
+
+  // Connect the input buffer so IN follows the level GPIOTE drives. Without it
+  //  IN always reads low, and virtual_timer_pin_stop() could not tell which
+  //  level to hand the pin back at
+  nrf_gpio_cfg(pin, NRF_GPIO_PIN_DIR_OUTPUT, NRF_GPIO_PIN_INPUT_CONNECT,
+      NRF_GPIO_PIN_NOPULL, NRF_GPIO_PIN_S0S1, NRF_GPIO_PIN_NOSENSE);
+
+  // GPIOTE takes over the pin, starting from its current level
+  uint32_t level = nrf_gpio_pin_out_read(pin) ? GPIOTE_CONFIG_OUTINIT_High : GPIOTE_CONFIG_OUTINIT_Low;
+  NRF_GPIOTE->CONFIG[gpiote_channel] = (GPIOTE_CONFIG_MODE_Task << GPIOTE_CONFIG_MODE_Pos) |
+                                       (pin << GPIOTE_CONFIG_PSEL_Pos) |
+                                       (GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos) |
+                                       (level << GPIOTE_CONFIG_OUTINIT_Pos);
+
+  NRF_PPI->CH[ppi_channel].EEP = (uint32_t)&timers[timer]->EVENTS_COMPARE[0];
+  NRF_PPI->CH[ppi_channel].TEP = (uint32_t)&NRF_GPIOTE->TASKS_OUT[gpiote_channel];
+  NRF_PPI->CHENSET = 1u << ppi_channel;
+
+  if (timer_users[timer] == 0) {
+    timer_periods[timer] = microseconds;
+    timer_configure(timer, microseconds);
+  }
+  timer_users[timer]++;
+
+  hardware_pins[gpiote_channel].active = true;
+  hardware_pins[gpiote_channel].pin = pin;
+  hardware_pins[gpiote_channel].timer = timer;
+  hardware_pins[gpiote_channel].ppi_channel = ppi_channel;
+  return gpiote_channel + 1;
+}
+
+void virtual_timer_pin_stop(uint32_t pin_timer_id) {
+  if (pin_timer_id == 0) {
+    return;
+  }
+
+  uint32_t index = pin_timer_id - 1;
+  if (index >= GPIOTE_CHANNELS) {
+    index -= GPIOTE_CHANNELS;
+    if (index < VIRTUAL_TIMER_PIN_SOFTWARE_SLOTS && software_pins[index].active) {
+      virtual_timer_cancel(software_pins[index].timer_id);
+      software_pins[index].active = false;
+    }
+    return;
+  }
+
+  hardware_pin_t* hardware_pin = &hardware_pins[index];
+  if (!hardware_pin->active) {
+    return;
+  }
+
+  NRF_PPI->CHENCLR = 1u << hardware_pin->ppi_channel;
+  NRF_PPI->CH[hardware_pin->ppi_channel].EEP = 0;
+  NRF_PPI->CH[hardware_pin->ppi_channel].TEP = 0;
+
+  // Hand the pin back to the GPIO port at the level GPIOTE left it. With the
+  //  PPI channel off nothing toggles it any more, so IN holds that level
+  if (nrf_gpio_pin_read(hardware_pin->pin)) {
+    nrf_gpio_pin_set(hardware_pin->pin);
+  } else {
+    nrf_gpio_pin_clear(hardware_pin->pin);
+  }
+  nrf_gpio_cfg_output(hardware_pin->pin);
+  NRF_GPIOTE->CONFIG[index] = 0;
+
+  timer_users[hardware_pin->timer]--;
+  if (timer_users[hardware_pin->timer] == 0) {
+    timers[hardware_pin->timer]->TASKS_STOP = 1;
+    timers[hardware_pin->timer]->SHORTS = 0;
+  }
+  hardware_pin->active = false;
+}
+
+void virtual_timer_pin_usage(virtual_timer_pin_usage_t* usage) {
+  usage->timers = 0;
+  usage->ppi_channels = 0;
+  usage->gpiote_channels = 0;
+  usage->software_pins = 0;
+
+  for (uint32_t timer = 0; timer < TIMER_COUNT; timer++) {
+    if (timer_users[timer] != 0) {
+      usage->timers++;
+    }
+  }
+  for (uint32_t channel = 0; channel < GPIOTE_CHANNELS; channel++) {
+    if (hardware_pins[channel].active) {
+      usage->ppi_channels++;
+      usage->gpiote_channels++;
+    }
+  }
+  for (uint32_t slot = 0; slot < VIRTUAL_TIMER_PIN_SOFTWARE_SLOTS; slot++) {
+    if (software_pins[slot].active) {
+      usage->software_pins++;
+    }
+  }
+}
+
+void virtual_timer_pin_usage_print(void) {
+  virtual_timer_pin_usage_t usage;
+  virtual_timer_pin_usage(&usage);
+  printf("Pin timers: %lu TIMERs, %lu PPI channels, %lu GPIOTE channels, %lu software pins\n",
+      usage.timers, usage.ppi_channels, usage.gpiote_channels, usage.software_pins);
+}
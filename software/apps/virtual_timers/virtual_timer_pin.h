@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+
+// Hardware pin timers
+//
+// A pin that only needs to toggle on a fixed period does not need the CPU.
+//  Each one gets its own TIMER, cleared by its own compare event, connected
+//  through a PPI channel to a GPIOTE task that toggles the pin. Pins with the
+//  same period share one TIMER. When no TIMER, PPI channel or GPIOTE channel
+//  is left, the pin is toggled from a repeated virtual timer instead.
+
+// TIMERs that may be used for pin timers, as a mask of TIMER numbers. TIMER4
+//  belongs to the virtual timer library, and TIMER0 is kept for the radio
+#ifndef VIRTUAL_TIMER_PIN_TIMERS
+#define VIRTUAL_TIMER_PIN_TIMERS ((1u << 1) | (1u << 2) | (1u << 3))
+#endif
+
+// Number of pins that can fall back to software toggling
+#ifndef VIRTUAL_TIMER_PIN_SOFTWARE_SLOTS
+#define VIRTUAL_TIMER_PIN_SOFTWARE_SLOTS 4
+#endif
+
+// Resources used by pin timers
+typedef struct {
+  uint32_t timers;
+  uint32_t ppi_channels;
+  uint32_t gpiote_channels;
+  uint32_t software_pins;
+} virtual_timer_pin_usage_t;
+
+// Toggle <pin> every <microseconds>. The pin must already be an output, and
+//  keeps its current level until the first toggle.
+// Call from the main loop, not from interrupt handlers or timer callbacks
+// Returns an ID for virtual_timer_pin_stop(), or 0 if neither hardware nor a
+//  software slot is left
+uint32_t virtual_timer_pin_toggle_repeated(uint32_t microseconds, uint32_t pin);
+
+// Stop toggling a pin, leaving it at its current level
+// Stopping a pin timer that was already stopped does nothing
+void virtual_timer_pin_stop(uint32_t pin_timer_id);
+
+// Get the TIMERs, PPI channels and GPIOTE channels in use, and the number of
+//  pins toggled in software
+void virtual_timer_pin_usage(virtual_timer_pin_usage_t* usage);
+
+// Print the resources in use
+void virtual_timer_pin_usage_print(void);
@@ -0,0 +1,92 @@
+// Node pool for virtual timers
+//
+// Free nodes are kept in a singly linked stack through their `next` field.
+//  IDs hold the generation in the upper 16 bits and the slot index in the
+//  lower 16 bits. Generations start at 1 and skip 0 when they wrap, so an ID
+//  is never 0.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "virtual_timer_pool.h"
+
+#define ID_INDEX_BITS 16
+#define ID_INDEX_MASK ((1u << ID_INDEX_BITS) - 1)
+
+#if VIRTUAL_TIMER_POOL_SIZE > ID_INDEX_MASK
+#error "VIRTUAL_TIMER_POOL_SIZE does not fit in a timer ID"
+#endif
+
+// storage for every node
+static node_t pool[VIRTUAL_TIMER_POOL_SIZE];
+
+// top of the free stack
+static node_t* free_nodes = NULL;
+
+// number of allocated nodes
+static uint32_t used_nodes = 0;
+
+
+// -- External functions
+
+void pool_init(void) {
+    free_nodes = NULL;
+    used_nodes = 0;
+    for (int32_t i = VIRTUAL_TIMER_POOL_SIZE - 1; i >= 0; i--) {
+        pool[i].generation = 1;
+        pool[i].allocated = false;
+        pool[i].next = free_nodes;
+        free_nodes = &pool[i];
+    }
+}
+
+node_t* pool_alloc(void) {
+    node_t* node = free_nodes;
+    if (node != NULL) {
+        free_nodes = node->next;
+        node->next = NULL;
+        node->allocated = true;
+        used_nodes++;
+    }
+    return node;
+}
+
+void pool_free(node_t* node) {
+    if (node == NULL || !node->allocated) {
+        return;
+    }
+
+    // invalidate existing IDs for this slot
+    node->generation++;
+    if (node->generation == 0) {
+        node->generation = 1;
+    }
+
+    node->allocated = false;
+    node->next = free_nodes;
+    free_nodes = node;
+    used_nodes--;
+}
+
+uint32_t pool_used(void) {
+    return used_nodes;
+}
+
+uint32_t pool_node_id(node_t* node) {
+    uint32_t index = node - pool;
+    return ((uint32_t)node->generation << ID_INDEX_BITS) | index;
+}
+
+node_t* pool_lookup(uint32_t id) {
+    uint32_t index = id & ID_INDEX_MASK;
+    if (index >= VIRTUAL_TIMER_POOL_SIZE) {
+        return NULL;
+    }
+
+    node_t* node = &pool[index];
+    if (!node->allocated || node->generation != (id >> ID_INDEX_BITS)) {
+        return NULL;
+    }
+    return node;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "virtual_timer_linked_list.h"
+
+// -- Pool functions
+//
+// Fixed-capacity pool of `node_t` used instead of `malloc()`. Every function
+//  is O(1) and must be called with interrupts disabled, which makes them safe
+//  to use from interrupt handlers.
+//
+// Each slot has a generation counter that is bumped whenever its node is
+//  freed. Node IDs combine the slot index with the generation, so an ID that
+//  refers to a freed (or reused) node is detected rather than acted upon.
+
+// The pool holds VIRTUAL_TIMER_POOL_SIZE nodes, set in "virtual_timer.h"
+
+
+// Mark every node in the pool as free
+void pool_init(void);
+
+
+// Allocate a node from the pool. Returns NULL if the pool is exhausted.
+node_t* pool_alloc(void);
+
+
+// Return a node to the pool. Any ID referring to it becomes stale.
+void pool_free(node_t* node);
+
+
+// Get the number of allocated nodes, which is the number of running timers.
+uint32_t pool_used(void);
+
+
+// Get the ID of an allocated node. IDs are never 0.
+uint32_t pool_node_id(node_t* node);
+
+
+// Find the allocated node with the given ID. Returns NULL if the ID is
+//  invalid or stale.
+node_t* pool_lookup(uint32_t id);
@@ -0,0 +1,112 @@
+// Expiry statistics for virtual timers
+//
+// Lateness is sorted into log2 buckets, so a single histogram covers both a
+//  few microseconds of interrupt latency and milliseconds of delay behind a
+//  slow callback. Handler durations come from the DWT cycle counter, which is
+//  much finer than the 1 us timer.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nrf.h"
+
+#include "virtual_timer_stats.h"
+
+#if VIRTUAL_TIMER_STATS
+
+static virtual_timer_stats_t stats;
+
+// CYCCNT when the counters were last cleared. The cycle counter is shared with
+//  debuggers and other code, so it is never written, only read relative to this
+static uint32_t cycle_baseline;
+
+
+// -- Helper functions
+
+// Bucket 0 holds 0, bucket i holds 2^(i-1) to 2^i - 1
+static uint32_t bucket_index(uint32_t lateness_us) {
+    if (lateness_us == 0) {
+        return 0;
+    }
+
+    uint32_t bucket = 32 - __builtin_clz(lateness_us);
+    if (bucket >= VIRTUAL_TIMER_STATS_BUCKETS) {
+        bucket = VIRTUAL_TIMER_STATS_BUCKETS - 1;
+    }
+    return bucket;
+}
+
+
+// -- External functions
+
+void stats_init(void) {
+    memset(&stats, 0, sizeof(stats));
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    cycle_baseline = DWT->CYCCNT;
+}
+
+uint32_t stats_cycles(void) {
+    return DWT->CYCCNT - cycle_baseline;
+}
+
+void stats_record_expiry(uint32_t lateness_us, uint32_t queue_length) {
+    stats.expiries++;
+    stats.lateness_histogram[bucket_index(lateness_us)]++;
+    if (lateness_us > stats.max_lateness_us) {
+        stats.max_lateness_us = lateness_us;
+    }
+
+    stats.total_queue_length += queue_length;
+    if (queue_length > stats.max_queue_length) {
+        stats.max_queue_length = queue_length;
+    }
+}
+
+void stats_record_interrupt(uint32_t cycles) {
+    stats.interrupts++;
+    stats.total_isr_cycles += cycles;
+    if (cycles > stats.max_isr_cycles) {
+        stats.max_isr_cycles = cycles;
+    }
+}
+
+void stats_copy(virtual_timer_stats_t* copy) {
+    *copy = stats;
+}
+
+void stats_print(const virtual_timer_stats_t* copy) {
+    printf("Virtual timer stats: %lu expiries\n", copy->expiries);
+    if (copy->expiries == 0) {
+        return;
+    }
+
+    printf("  lateness (us)      count\n");
+    for (uint32_t i = 0; i < VIRTUAL_TIMER_STATS_BUCKETS; i++) {
+        uint32_t count = copy->lateness_histogram[i];
+        if (count == 0) {
+            continue;
+        }
+        if (i == 0) {
+            printf("  %8d          %8lu\n", 0, count);
+        } else if (i == VIRTUAL_TIMER_STATS_BUCKETS - 1) {
+            printf("  %8lu+         %8lu\n", 1ul << (i - 1), count);
+        } else {
+            printf("  %8lu-%-8lu %8lu\n", 1ul << (i - 1), (1ul << i) - 1, count);
+        }
+    }
+    printf("  max lateness: %lu us\n", copy->max_lateness_us);
+
+    printf("  queue length at expiry: %lu avg, %lu max\n",
+        copy->total_queue_length / copy->expiries, copy->max_queue_length);
+    if (copy->interrupts != 0) {
+        printf("  interrupt handler: %lu runs, %lu cycles avg, %lu cycles max\n",
+            copy->interrupts, (uint32_t)(copy->total_isr_cycles / copy->interrupts),
+            copy->max_isr_cycles);
+    }
+}
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "virtual_timer.h"
+
+// -- Statistics functions
+//
+// Instrumentation for the timer interrupt handler, enabled by setting
+//  VIRTUAL_TIMER_STATS to 1 in "virtual_timer.h". When disabled these
+//  functions do nothing and compile away.
+//
+// The record functions are only called from the timer interrupt handler, so
+//  the counters have a single writer. Readers must disable interrupts while
+//  copying them.
+
+#if VIRTUAL_TIMER_STATS
+
+
+// Clear every counter, enable the DWT cycle counter if it is off and record
+//  its current value as the baseline. CYCCNT itself is left running
+void stats_init(void);
+
+
+// Read the DWT cycle counter relative to the baseline, used to time the
+//  interrupt handler. Differences stay correct across the 32-bit wrap
+uint32_t stats_cycles(void);
+
+
+// Record a timer that ran <lateness_us> after its scheduled time, while
+//  <queue_length> timers were running
+void stats_record_expiry(uint32_t lateness_us, uint32_t queue_length);
+
+
+// Record one run of the timer interrupt handler that took <cycles>
+void stats_record_interrupt(uint32_t cycles);
+
+
+// Copy the counters into <stats>
+void stats_copy(virtual_timer_stats_t* stats);
+
+
+// Print the counters in <stats>
+void stats_print(const virtual_timer_stats_t* stats);
+
+#else
+
+static inline void stats_init(void) {
+}
+
+static inline uint32_t stats_cycles(void) {
+    return 0;
+}
+
+static inline void stats_record_expiry(uint32_t lateness_us, uint32_t queue_length) {
+}
+
+static inline void stats_record_interrupt(uint32_t cycles) {
+}
+
+#endif
@@ -0,0 +1,330 @@
+// Hierarchical timing wheel for virtual timers
+//
+// Timers are hashed into WHEEL_LEVELS levels of WHEEL_SLOTS slots based on how
+//  far in the future they expire. Level 0 has one-microsecond slots, and each
+//  level above it is WHEEL_SLOTS times coarser. When the wheel reaches the
+//  start of a coarse slot, the timers in it are cascaded down into finer
+//  levels, so a timer is moved at most WHEEL_LEVELS-1 times in its lifetime.
+//
+// Each slot is an unsorted doubly linked list, so inserting and removing a
+//  timer never walks other timers. A bitmap per level tracks which slots are
+//  occupied, which lets the next event be found without visiting empty slots.
+//  The wheel is tickless: it jumps straight from one event to the next.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_error.h"
+#include "nrf.h"
+#include "nrf_delay.h"
+
+#include "virtual_timer_wheel.h"
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1u << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+
+// Levels cover 2^36 microseconds (about 19 hours). Timers further out than
+//  that are kept in the top level and cascaded back into it until they are
+//  within range
+#define WHEEL_LEVELS 6
+
+// slots for all levels, level 0 first
+static node_t* wheel[WHEEL_LEVELS * WHEEL_SLOTS];
+
+// bitmap of occupied slots for each level
+static uint64_t occupied[WHEEL_LEVELS];
+
+// time the wheel has advanced to. Cascades for this time have been performed
+//  and the level 0 slot for this time holds timers that have expired
+static uint64_t wheel_time = 0;
+
+
+// -- Internal functions
+
+static inline uint32_t level_shift(uint32_t level) {
+    return level * WHEEL_BITS;
+}
+
+static inline uint32_t current_slot(void) {
+    return wheel_time & WHEEL_MASK;
+}
+
+// rotate the bitmap so that bit <amount> becomes bit 0
+static inline uint64_t rotate_right(uint64_t bits, uint32_t amount) {
+    amount &= 63;
+    if (amount == 0) {
+        return bits;
+    }
+    return (bits >> amount) | (bits << (64 - amount));
+}
+
+// add node to the head of the slot at <index>
+static void slot_push(uint32_t index, node_t* node) {
+    node->wheel_index = index;
+    node->prev = NULL;
+    node->next = wheel[index];
+    if (node->next != NULL) {
+        node->next->prev = node;
+    }
+    wheel[index] = node;
+    occupied[index / WHEEL_SLOTS] |= (1ull << (index % WHEEL_SLOTS));
+}
+
+// remove node from whichever slot it is in
+static void slot_unlink(node_t* node) {
+    uint32_t index = node->wheel_index;
+
+    if (node->prev != NULL) {
+        node->prev->next = node->next;
+    } else {
+        wheel[index] = node->next;
+        if (wheel[index] == NULL) {
+            occupied[index / WHEEL_SLOTS] &= ~(1ull << (index % WHEEL_SLOTS));
+        }
+    }
+    if (node->next != NULL) {
+        node->next->prev = node->prev;
+    }
+
+    node->next = NULL;
+    node->prev = NULL;
+    node->wheel_index = WHEEL_INDEX_NONE;
+}
+
+// hash node into the wheel based on how far past `wheel_time` it expires
+static void place(node_t* node) {
+    uint64_t delta = node->timer_value - wheel_time;
+
+    if ((int64_t)delta <= 0) {
+        // already expired, goes in the current slot
+        slot_push(current_slot(), node);
+        return;
+    }
+
+    // the level is picked by the highest bit set in the distance
+    uint32_t level = (63 - __builtin_clzll(delta)) / WHEEL_BITS;
+    if (level >= WHEEL_LEVELS) {
+        level = WHEEL_LEVELS - 1;
+    }
+    uint32_t slot = (node->timer_value >> level_shift(level)) & WHEEL_MASK;
+    slot_push(level * WHEEL_SLOTS + slot, node);
+}
+
+// find the number of microseconds from `wheel_time` to the next cascade
+// returns false if all upper levels are empty
+static bool next_cascade_distance(uint64_t* distance) {
+    bool found = false;
+    uint64_t best = UINT64_MAX;
+
+    // upper level slots are cascaded when the wheel reaches the start of them
+    for (uint32_t level = 1; level < WHEEL_LEVELS; level++) {
+        if (occupied[level] == 0) {
+            continue;
+        }
+
+        uint32_t shift = level_shift(level);
+        uint64_t boundary = (wheel_time | ((1ull << shift) - 1)) + 1;
+        uint32_t index = (boundary >> shift) & WHEEL_MASK;
+        uint64_t steps = __builtin_ctzll(rotate_right(occupied[level], index));
+        uint64_t level_distance = boundary + (steps << shift) - wheel_time;
+
+        if (level_distance < best) {
+            best = level_distance;
+        }
+        found = true;
+    }
+
+    *distance = best;
+    return found;
+}
+
+// find the number of microseconds from `wheel_time` to the next event
+// returns false if the wheel is empty
+static bool next_event_distance(uint64_t* distance) {
+    // expired timers are still waiting to be removed
+    if (occupied[0] & (1ull << current_slot())) {
+        *distance = 0;
+        return true;
+    }
+
+    bool found = next_cascade_distance(distance);
+
+    // level 0 slots expire one microsecond apart, starting after the current one
+    if (occupied[0] != 0) {
+        uint64_t bits = rotate_right(occupied[0], current_slot() + 1);
+        uint64_t level_distance = 1 + __builtin_ctzll(bits);
+        if (!found || level_distance < *distance) {
+            *distance = level_distance;
+        }
+        found = true;
+    }
+
+    return found;
+}
+
+// move the wheel forward. There must be no events in between
+static void advance(uint64_t distance) {
+    wheel_time += distance;
+
+    // cascade each level whose slot starts at this time
+    for (uint32_t level = 1; level < WHEEL_LEVELS; level++) {
+        uint32_t shift = level_shift(level);
+        if ((wheel_time & ((1ull << shift) - 1)) != 0) {
+            break;
+        }
+
+        uint32_t slot = (wheel_time >> shift) & WHEEL_MASK;
+        uint32_t index = level * WHEEL_SLOTS + slot;
+        node_t* node = wheel[index];
+        wheel[index] = NULL;
+        occupied[level] &= ~(1ull << slot);
+
+        while (node != NULL) {
+            node_t* next = node->next;
+            place(node);
+            node = next;
+        }
+    }
+}
+
+// process all events up to <now>, stopping early if timers have expired
+static void catch_up(uint64_t now) {
+    while ((occupied[0] & (1ull << current_slot())) == 0) {
+        uint64_t elapsed = now - wheel_time;
+        uint64_t distance = 0;
+
+        if (!next_event_distance(&distance) || distance > elapsed) {
+            // nothing happens before now, so jump straight there
+            if (elapsed != 0) {
+                advance(elapsed);
+            }
+            return;
+        }
+        advance(distance);
+    }
+}
+
+
+// -- External functions
+
+void wheel_init(uint64_t now) {
+    for (uint32_t i = 0; i < WHEEL_LEVELS * WHEEL_SLOTS; i++) {
+        wheel[i] = NULL;
+    }
+    for (uint32_t i = 0; i < WHEEL_LEVELS; i++) {
+        occupied[i] = 0;
+    }
+    wheel_time = now;
+}
+
+void wheel_insert(node_t* node, uint64_t now) {
+    // fault if given a NULL node
+    if (node == NULL) {
+        printf("\n***\nERROR: node passed into `wheel_insert` was NULL!!\n***\n");
+        nrf_delay_ms(100);
+        APP_ERROR_CHECK(NRF_ERROR_NULL);
+    }
+
+    // distances are measured from `wheel_time`, so keep it close to now
+    catch_up(now);
+    place(node);
+}
+
+void wheel_remove(node_t* node) {
+    // fault if given a NULL node
+    if (node == NULL) {
+        printf("\n***\nERROR: node passed into `wheel_remove` was NULL!!\n***\n");
+        nrf_delay_ms(100);
+        APP_ERROR_CHECK(NRF_ERROR_NULL);
+    }
+
+    if (node->wheel_index != WHEEL_INDEX_NONE) {
+        slot_unlink(node);
+    }
+}
+
+uint32_t wheel_next_events(uint64_t* event_times, uint32_t max_events) {
+    uint32_t count = 0;
+    if (max_events == 0) {
+        return 0;
+    }
+
+    // expired timers are still waiting to be removed
+    if (occupied[0] & (1ull << current_slot())) {
+        event_times[count++] = wheel_time;
+    }
+
+    // Timers cascaded down by the next cascade are not in level 0 yet, so the
+    //  list has to stop there
+    uint64_t cascade = 0;
+    bool has_cascade = next_cascade_distance(&cascade);
+
+    // level 0 slots in the order they expire
+    uint64_t pending = occupied[0] & ~(1ull << current_slot());
+    uint64_t bits = rotate_right(pending, current_slot() + 1);
+    while (bits != 0 && count < max_events) {
+        uint64_t distance = 1 + __builtin_ctzll(bits);
+        if (has_cascade && distance >= cascade) {
+            break;
+        }
+        event_times[count++] = wheel_time + distance;
+        bits &= bits - 1;
+    }
+
+    if (has_cascade && count < max_events) {
+        event_times[count++] = wheel_time + cascade;
+    }
+    return count;
+}
+
+node_t* wheel_find_overlapping(uint64_t from, uint64_t to, uint64_t window_start, uint64_t window_end) {
+    node_t* found = NULL;
+    for (uint32_t level = 0; level < WHEEL_LEVELS; level++) {
+        // slots of this level that can hold a time in the range. A slot may
+        //  also hold timers from another turn of the level, which are skipped
+        //  by checking their time
+        uint64_t first = from >> level_shift(level);
+        uint64_t last = to >> level_shift(level);
+        if (last - first >= WHEEL_MASK) {
+            last = first + WHEEL_MASK;
+        }
+
+        for (uint64_t slot = first; slot <= last; slot++) {
+            if (!(occupied[level] & (1ull << (slot & WHEEL_MASK)))) {
+                continue;
+            }
+            uint32_t index = level * WHEEL_SLOTS + (slot & WHEEL_MASK);
+            for (node_t* node = wheel[index]; node != NULL; node = node->next) {
+                if (node->timer_value < from || node->timer_value > to ||
+                        node->deadline > window_end || node->deadline + node->slack < window_start) {
+                    continue;
+                }
+                if (found == NULL || node->timer_value > found->timer_value) {
+                    found = node;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+bool wheel_next_event(uint64_t* event_time) {
+    uint64_t distance = 0;
+    if (!next_event_distance(&distance)) {
+        return false;
+    }
+    *event_time = wheel_time + distance;
+    return true;
+}
+
+node_t* wheel_remove_expired(uint64_t now) {
+    catch_up(now);
+
+    node_t* node = wheel[current_slot()];
+    if (node != NULL) {
+        slot_unlink(node);
+    }
+    return node;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "virtual_timer_linked_list.h"
+
+// -- Wheel functions
+//
+// The hierarchical timing wheel holds the same `node_t` as the linked list,
+//  but inserting and removing a timer are O(1). Timers are ordered by
+//  `timer_value`, which must be set before the node is inserted.
+
+// Value of `node->wheel_index` for nodes that are not in the wheel
+#define WHEEL_INDEX_NONE 0xFFFF
+
+
+// Empty the wheel and start it at time <now>
+void wheel_init(uint64_t now);
+
+
+// Insert node into the wheel. <now> is the current time, which must never go
+//  backwards between calls.
+void wheel_insert(node_t* node, uint64_t now);
+
+
+// Remove the specified node from the wheel if it is in it. Note that the
+//  memory for the node is NOT automatically freed.
+void wheel_remove(node_t* node);
+
+
+// Get the time of the next event in the wheel. This is either the expiration
+//  of a timer or the time at which coarse timers need to be moved to a finer
+//  level of the wheel. The time may already be in the past.
+// Returns false if the wheel is empty
+bool wheel_next_event(uint64_t* event_time);
+
+
+// Get the times of up to <max_events> upcoming events, earliest first. The
+//  list ends early at the next cascade, since the timers it moves into level 0
+//  are not known until it happens.
+// Returns the number of event times written
+uint32_t wheel_next_events(uint64_t* event_times, uint32_t max_events);
+
+
+// Find a timer in the wheel that expires between <from> and <to>, inclusive,
+//  and could expire anywhere from <window_start> to <window_end>: its window
+//  from `deadline` to `deadline + slack` overlaps that one. The latest such
+//  timer is returned. Only the slots that can hold a time in the range are
+//  visited.
+// Returns NULL if there is none
+node_t* wheel_find_overlapping(uint64_t from, uint64_t to, uint64_t window_start, uint64_t window_end);
+
+
+// Remove and return a timer that has expired at <now>. Returns NULL if no
+//  timers have expired.
+node_t* wheel_remove_expired(uint64_t now);
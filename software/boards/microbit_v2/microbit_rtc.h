@@ -0,0 +1,72 @@
+// Keep time with an RTC
+//
+// Drivers that count time in RTC ticks share these helpers. The 24-bit
+// counter wraps every 512 seconds at 32.768 kHz, so each driver counts wraps
+// in an epoch from its RTC's OVRFLW interrupt and reads a 64-bit tick count
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+
+// Disable interrupts, returning the previous state so that critical sections
+//  also work when called from an interrupt handler or a callback
+static inline uint32_t critical_enter(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+static inline void critical_exit(uint32_t primask) {
+  __set_PRIMASK(primask);
+}
+
+// Start the 32.768 kHz clock for the RTCs, unless it is already running
+static inline void lfclk_start(void) {
+  // the micro:bit has no 32.768 kHz crystal, so use the internal RC oscillator
+  if (!(NRF_CLOCK->LFCLKSTAT & CLOCK_LFCLKSTAT_STATE_Msk)) {
+    NRF_CLOCK->LFCLKSRC = CLOCK_LFCLKSRC_SRC_RC << CLOCK_LFCLKSRC_SRC_Pos;
+    NRF_CLOCK->EVENTS_LFCLKSTARTED = 0;
+    NRF_CLOCK->TASKS_LFCLKSTART = 1;
+    while (NRF_CLOCK->EVENTS_LFCLKSTARTED == 0);
+    NRF_CLOCK->EVENTS_LFCLKSTARTED = 0;
+  }
+}
+
+// Start the low frequency clock, then stop <rtc>, clear its counter and set it
+//  to count every 32.768 kHz tick. The caller sets up compares and starts it
+static inline void rtc_setup(NRF_RTC_Type* rtc) {
+  lfclk_start();
+  rtc->TASKS_STOP = 1;
+  rtc->TASKS_CLEAR = 1;
+  rtc->PRESCALER = 0;
+}
+
+// Convert between RTC ticks at 32768 Hz and microseconds. 1000000 / 32768 is
+//  exactly 15625 / 512. Microseconds round up to the next tick, so a tick
+//  deadline is never early
+static inline uint64_t rtc_ticks_to_us(uint64_t ticks) {
+  return (ticks * 15625) >> 9;
+}
+
+static inline uint64_t rtc_us_to_ticks(uint64_t us) {
+  return ((us << 9) + 15624) / 15625;
+}
+
+// Read <rtc> as a 64-bit tick count. <epoch> counts the counter wraps and is
+//  advanced by the RTC's OVRFLW interrupt handler
+static inline uint64_t rtc_read_ticks(NRF_RTC_Type* rtc, volatile uint32_t* epoch) {
+  uint32_t primask = critical_enter();
+  uint32_t counter = rtc->COUNTER;
+  uint32_t high = *epoch;
+
+  // the counter wrapped, but the interrupt handler has not counted it yet
+  if (rtc->EVENTS_OVRFLW && counter < 0x800000) {
+    high++;
+  }
+  critical_exit(primask);
+
+  return ((uint64_t)high << 24) | counter;
+}
@@ -0,0 +1,59 @@
+// Sleep while waiting
+//
+// Blocking code that waits for an interrupt handler or a peripheral event
+// can sleep in WFE instead of spinning on a flag. The CPU then stops until an
+// interrupt is pending, and wakes within a few cycles of it
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+
+// Clear FPU exception flags before sleeping
+// The FPU raises an interrupt for every inexact result, which stays pending
+//  and wakes WFE again straight away (nRF52 errata 87)
+static inline void microbit_sleep_clear_fpu(void) {
+#if (__FPU_USED == 1)
+  __set_FPSCR(__get_FPSCR() & ~0x0000009Fu);
+  (void)__get_FPSCR();
+  NVIC_ClearPendingIRQ(FPU_IRQn);
+#endif
+}
+
+// Sleep until an interrupt handler sets <flag>
+// Interrupts are masked around the check, so a handler that runs just before
+//  WFE cannot be missed. SEVONPEND lets the masked interrupt wake WFE, and it
+//  runs as soon as they are unmasked again
+// Must not be called with interrupts disabled, or from a handler at the same
+//  or higher priority than the one that sets <flag>
+static inline void sleep_until_flag(volatile bool* flag) {
+  SCB->SCR |= SCB_SCR_SEVONPEND_Msk;
+  __disable_irq();
+  while (!*flag) {
+    microbit_sleep_clear_fpu();
+    __WFE();
+    __enable_irq();
+    __disable_irq();
+  }
+  __enable_irq();
+}
+
+// Sleep until a peripheral sets <event>, without an interrupt handler
+// The peripheral's interrupt must be enabled with INTENSET but left disabled in
+//  the NVIC. The event then makes <irq> pending, which wakes WFE through
+//  SEVONPEND, and no handler runs. <irq> is left pending, and the caller
+//  clears <event> as usual
+static inline void sleep_until_event(volatile uint32_t* event, IRQn_Type irq) {
+  SCB->SCR |= SCB_SCR_SEVONPEND_Msk;
+
+  // only a change to pending wakes WFE, so an interrupt left pending by the
+  //  last call would never wake it
+  NVIC_ClearPendingIRQ(irq);
+  while (!*event) {
+    microbit_sleep_clear_fpu();
+    __WFE();
+    NVIC_ClearPendingIRQ(irq);
+  }
+}